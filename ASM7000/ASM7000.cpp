@@ -1,10 +1,25 @@
 #include "Options.h"
 #include "Parser.h"
 #include "Source.h"
-
+#include "LineIR.h"
+#include "Prefetcher.h"
+#include "IncludeGuard.h"
+#include "ExpandedSource.h"
+#include "LineFilter.h"
+#include "Opcodes.h"
+#include "Encodings.h"
+#include "Cpu.h"
+#include "Arena.h"
+
+#include <fstream>
 #include <iomanip>
 #include <sstream>
 
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#endif
+
 using namespace std;
 
 const char title[] = "** TMS-7000 Tiny Assembler - v0.3.0-alpha+dev - (C) 2024 GmEsoft, All rights reserved. **";
@@ -14,11 +29,21 @@ const char help[] =
 	"         -I:inputfile[.asm[   input source file\n"
 	"         -O:outputfile[.cim]  output object file\n"
 	"         -L:listing[.lst]     listing file\n"
-	"Options: -NC  no compatibility warning\n"
+	"         -P:directory         include search path, may be repeated\n"
+	"         -E[:expanded[.i]]    preprocess only: write the expanded source\n"
+	"                              and its line origins to expanded.loc, or to\n"
+	"                              inputfile.loc if expanded is standard output\n"
+	"         file '-' is standard input or output\n"
+	"Options: -1   single pass, forward references fixed up\n"
+	"         -CPU:name  CPU variant checked: TMS7000, TMS7001, TMS7042, ...\n"
+	"         -CS  case-sensitive: no folding to upper case\n"
+	"         -M   report the arena allocations of each pass\n"
+	"         -NC  no compatibility warning\n"
 	"         -ND- enable debug output\n"
 	"         -NE  no output to stderr\n"
 	"         -NH  no header in listing\n"
 	"         -NN  no line numbers in listing\n"
+	"         -NR  no repeated include of a file\n"
 	"         -NW  no warning\n"
 	;
 
@@ -30,8 +55,21 @@ stack< Options > optstack;
 
 Options options;
 
+StringPool stringpool;
+
 Symbols symbols;
 
+Expressions expressions;
+
+Fixups fixups;
+
+SourceCache sourcecache;
+
+IncludePath includepath;
+
+const CpuModel *cpumodel = Cpus::find( "GENERIC" );
+Prefetcher prefetcher( sourcecache, includepath );
+
 
 FunctionSeq_t functions;
 
@@ -39,10 +77,14 @@ FunctionSeq_t functions;
 
 #define enum_pair( A, B ) ( ( (A) << 4 ) | (B) )
 
+// Containers of a line, allocated in the per-line arena.
+typedef vector< Arg, ArenaAllocator< Arg > >	args_t;
+typedef vector< byte, ArenaAllocator< byte > >	instr_t;
+
 
 /////// ARGS //////////////////////////////////////////////////////////////////
 
-bool chkargs( const string& op, const vector< Arg > &args, size_t num )
+bool chkargs( const string& op, const args_t &args, size_t num )
 {
 	if ( args.size() < num )
 		log.error( "%s: Too few args %d, expecting %d", op.data(), args.size(), num );
@@ -54,16 +96,16 @@ bool chkargs( const string& op, const vector< Arg > &args, size_t num )
 word getimmediate( const Arg &arg )
 {
 	if ( arg.type != ARG_IMM )
-		log.error( "Expecting immediate: [%s] (%s)", arg.str.data(), ArgTypes::get(arg.type) );
+		log.error( "Expecting immediate: [%s] (%s)", arg.getstr().data(), ArgTypes::get(arg.type) );
 	return arg.data;
 }
 
 word getbyte( const Arg &arg )
 {
 	if ( arg.type != ARG_IMM && arg.type != ARG_REG )
-		log.error( "Bad byte type: [%s]=%04X (%s)", arg.str.data(), arg.data, ArgTypes::get(arg.type) );
+		log.error( "Bad byte type: [%s]=%04X (%s)", arg.getstr().data(), arg.data, ArgTypes::get(arg.type) );
 	else if ( short( arg.data ) < -128 || arg.data > 255 )
-		log.error( "Byte range error: [%s]=%04X (%s)", arg.str.data(), arg.data, ArgTypes::get(arg.type) );
+		log.error( "Byte range error: [%s]=%04X (%s)", arg.getstr().data(), arg.data, ArgTypes::get(arg.type) );
 	return arg.data & 0xFF;
 }
 
@@ -83,7 +125,7 @@ word getnum( const Arg &arg )
 	if ( arg.type == ARG_PORT )
 		ret -= 0x100;
 	if ( ret > 0xFF )
-		log.error( "Number range error: [%s]=%d (%s)", arg.str.data(), arg.data, ArgTypes::get(arg.type) );
+		log.error( "Number range error: [%s]=%d (%s)", arg.getstr().data(), arg.data, ArgTypes::get(arg.type) );
 	return ret & 0xFF;
 }
 
@@ -92,376 +134,305 @@ word getoffset( word addr, const Arg &arg )
 	short offset = arg.data - addr;
 	if ( offset < -128 || offset > 127 )
 	{
-		log.error( "Offset range error: [%s] (%s)", arg.str.data(), ArgTypes::get(arg.type) );
+		log.error( "Offset range error: [%s] (%s)", arg.getstr().data(), ArgTypes::get(arg.type) );
 	}
 	return offset & 0xFF;
 }
 
-void ass_mov( const string op, vector< Arg > &args, vector< byte > &instr )
+
+/////// EMIT //////////////////////////////////////////////////////////////////
+
+// Append an operand to the instruction. In single-pass mode, an operand
+// referring to an undefined symbol is emitted as a placeholder and fixed up
+// when the symbol gets defined.
+
+void emitfixup( instr_t &instr, FixupKind kind, word base, const Arg &arg )
 {
-	//			Rn,A	%n,A	Rn,B	Rn,Rn	%n,B	B,A		%n,R	A,B		A,Rn	B,Rn
-	// 	AND		12		22		32		42		52		62		72		C0		D0		D1
-	if ( chkargs( op, args, 2 ) )
-	{
-		switch( enum_pair( args[0].type, args[1].type ) )
-		{
-		case enum_pair( ARG_REG, ARG_A ):
-			instr.push_back( 0x12 );
-			instr.push_back( getnum( args[0] ) );
-			break;
-		case enum_pair( ARG_IMM, ARG_A ):
-			instr.push_back( 0x22 );
-			instr.push_back( getbyte( args[0] ) );
-			break;
-		case enum_pair( ARG_REG, ARG_B ):
-			instr.push_back( 0x32 );
-			instr.push_back( getnum( args[0] ) );
-			break;
-		case enum_pair( ARG_REG, ARG_REG ):
-			instr.push_back( 0x42 );
-			instr.push_back( getnum( args[0] ) );
-			instr.push_back( getnum( args[1] ) );
-			break;
-		case enum_pair( ARG_IMM, ARG_B ):
-			instr.push_back( 0x52 );
-			instr.push_back( getbyte( args[0] ) );
-			break;
-		case enum_pair( ARG_B, ARG_A ):
-			instr.push_back( 0x62 );
-			break;
-		case enum_pair( ARG_IMM, ARG_REG ):
-			instr.push_back( 0x72 );
-			instr.push_back( getbyte( args[0] ) );
-			instr.push_back( getnum( args[1] ) );
-			break;
-		case enum_pair( ARG_A, ARG_B ):
-			instr.push_back( 0xC0 );
-			break;
-		case enum_pair( ARG_A, ARG_REG ):
-			instr.push_back( 0xD0 );
-			instr.push_back( getnum( args[1] ) );
-			break;
-		case enum_pair( ARG_B, ARG_REG ):
-			instr.push_back( 0xD1 );
-			instr.push_back( getnum( args[1] ) );
-			break;
-		default:
-			log.error( "Bad arg(s): %s %s,%s (%s,%s)",
-				op.data(), args[0].str.data(), args[1].str.data(), ArgTypes::get(args[0].type), ArgTypes::get(args[1].type) );
-		}
-	}
+	fixups.add( kind, instr.size(), base, pc, arg.getstr(), arg.undef );
+	instr.push_back( 0 );
+	if ( kind == FIX_WORD )
+		instr.push_back( 0 );
+}
+
+void emitbyte( instr_t &instr, const Arg &arg )
+{
+	if ( arg.undef )
+		emitfixup( instr, FIX_BYTE, 0, arg );
+	else
+		instr.push_back( getbyte( arg ) );
+}
+
+void emitnum( instr_t &instr, const Arg &arg )
+{
+	if ( arg.undef )
+		emitfixup( instr, FIX_NUM, 0, arg );
+	else
+		instr.push_back( getnum( arg ) );
 }
 
-void ass_movd( const string op, vector< Arg > &args, vector< byte > &instr )
+void emitword( instr_t &instr, const Arg &arg )
 {
-	//			%n,Rn	Rn,Rn	%n(B),Rn
-	//	MOVD	88		A8		98
-	if ( chkargs( op, args, 2 ) )
+	if ( arg.undef )
 	{
-		switch( enum_pair( args[0].type, args[1].type ) )
-		{
-		case enum_pair( ARG_IMM, ARG_REG ):
-			instr.push_back( 0x88 );
-			instr.push_back( gethigh( args[0] ) );
-			instr.push_back( getlow( args[0] ) );
-			instr.push_back( getnum( args[1] ) );
-			break;
-		case enum_pair( ARG_REG, ARG_REG ):
-			instr.push_back( 0x98 );
-			instr.push_back( getnum( args[0] ) );
-			instr.push_back( getnum( args[1] ) );
-			break;
-		case enum_pair( ARG_EFFEC, ARG_REG ):
-			instr.push_back( 0xA8 );
-			instr.push_back( gethigh( args[0] ) );
-			instr.push_back( getlow( args[0] ) );
-			instr.push_back( getnum( args[1] ) );
-			break;
-		default:
-			log.error( "Bad arg(s): %s %s,%s (%s,%s)",
-				op.data(), args[0].str.data(), args[1].str.data(), ArgTypes::get(args[0].type), ArgTypes::get(args[1].type) );
-		}
+		emitfixup( instr, FIX_WORD, 0, arg );
+	}
+	else
+	{
+		instr.push_back( gethigh( arg ) );
+		instr.push_back( getlow( arg ) );
 	}
 }
 
-void ass_movp( const string op, vector< Arg > &args, vector< byte > &instr )
+void emitoffset( instr_t &instr, word addr, const Arg &arg )
+{
+	if ( arg.undef )
+		emitfixup( instr, FIX_REL8, addr, arg );
+	else
+		instr.push_back( getoffset( addr, arg ) );
+}
+
+// Patches the fixups waiting for a symbol that just got defined.
+void resolvefixups( const string &name, vector< byte > &image )
 {
-	//			A,Pn	B,Pn	%n,Pn	Pn,A	Pn,B
-	//	MOVD	82		A2		92		80		91
-	if ( chkargs( op, args, 2 ) )
+	vector< Fixup > waiting;
+	fixups.take( name, waiting );
+
+	size_t count = fixups.undefinedNames().size();
+	word savepc = pc;
+
+	for ( size_t i=0; i<waiting.size(); ++i )
 	{
-		switch( enum_pair( args[0].type, args[1].type ) )
+		const Fixup &fixup = waiting[i];
+		pc = fixup.pc;
+		Arg arg = Parser::getarg( fixup.expr );
+		if ( arg.undef )
 		{
-		case enum_pair( ARG_A, ARG_PORT ):
-			instr.push_back( 0x82 );
-			instr.push_back( getnum( args[1] ) );
-			break;
-		case enum_pair( ARG_B, ARG_PORT ):
-			instr.push_back( 0x92 );
-			instr.push_back( getnum( args[1] ) );
+			fixups.wait( fixups.undefinedName( arg.undef ), fixup );
+			continue;
+		}
+		switch ( fixup.kind )
+		{
+		case FIX_BYTE:
+			image[fixup.index] = byte( getbyte( arg ) );
 			break;
-		case enum_pair( ARG_IMM, ARG_PORT ):
-			instr.push_back( 0xA2 );
-			instr.push_back( getbyte( args[0] ) );
-			instr.push_back( getnum( args[1] ) );
+		case FIX_NUM:
+			image[fixup.index] = byte( getnum( arg ) );
 			break;
-		case enum_pair( ARG_PORT, ARG_A ):
-			instr.push_back( 0x80 );
-			instr.push_back( getnum( args[0] ) );
+		case FIX_WORD:
+			image[fixup.index] = byte( gethigh( arg ) );
+			image[fixup.index + 1] = byte( getlow( arg ) );
 			break;
-		case enum_pair( ARG_PORT, ARG_B ):
-			instr.push_back( 0x91 );
-			instr.push_back( getnum( args[0] ) );
+		case FIX_REL8:
+			image[fixup.index] = byte( getoffset( fixup.base, arg ) );
 			break;
-		default:
-			log.error( "Bad arg(s): %s %s,%s (%s,%s)",
-				op.data(), args[0].str.data(), args[1].str.data(), ArgTypes::get(args[0].type), ArgTypes::get(args[1].type) );
 		}
 	}
+
+	pc = savepc;
+	fixups.dropUndefined( count );
 }
 
-void ass_xaddr( const string op, vector< Arg > &args, int bits, vector< byte > &instr )
+// Reports the fixups still waiting for a symbol.
+void unresolvedfixups()
 {
-	//			@n		*Rn		@n(B)
-	//	LDA		8A		9A		AA
-	//	STA		8B		9B		AB
-	//	BR		8C		9C		AC
-	//	CMPA	8D		9D		AD
-	//	CALL	8E		9E		AE
-	if ( chkargs( op, args, 1 ) )
+	fixups_t &pending = fixups.pending();
+	for ( fixupptr_t it = pending.begin(); it != pending.end(); ++it )
 	{
-		switch( args[0].type )
-		{
-		case ARG_IMM: // extension
-		case ARG_REG: // extension
-			if ( !options.nocompatwarning )
-				log.warn( "Got type %s, assuming DIR: %s=%04X", ArgTypes::get(args[0].type), args[0].str.data(), args[0].data );
-		case ARG_DIR:
-			instr.push_back( 0x80 | bits );
-			instr.push_back( gethigh( args[0] ) );
-			instr.push_back( getlow( args[0] ) );
-			break;
-		case ARG_INDIR:
-			instr.push_back( 0x90 | bits );
-			instr.push_back( getnum( args[0] ) );
-			break;
-		case ARG_INDEX:
-			instr.push_back( 0xA0 | bits );
-			instr.push_back( gethigh( args[0] ) );
-			instr.push_back( getlow( args[0] ) );
-			break;
-		default:
-			log.error( "Bad arg: %s [%s] (%s)", op.data(), args[0].str.data(), ArgTypes::get(args[0].type) );
-			instr.push_back( 0x80 | bits );
-			instr.push_back( gethigh( args[0] ) );
-			instr.push_back( getlow( args[0] ) );
-		}
+		log.error( "Unresolved forward reference: [%s] at %04X (%s)",
+			it->second.expr.data(), it->second.pc, it->first.data() );
 	}
+	pending.clear();
 }
 
-bool ass_unop( const string op, vector< Arg > &args, int num, int bits, vector< byte > &instr )
+// Checks a register or port operand against the register file and the
+// on-chip ports of the CPU variant.
+template< class Cpu >
+void checkoperand( const Arg &arg )
 {
-	//			A		B		Rn
-	// 	DEC		B2		C2		D2
-	//	INC		B3		C3		D3
-	//	INV		B4		C4		D4
-	//	CLR		B5		C5		D5
-	//	XCHB	B6		C6		D6
-	//	SWAP	B7		C7		D7
-	//	PUSH	B8		C8		D8
-	//	POP		B9		C9		D9
-	//	DJNZ	BA		CA		DA
-	//	DECD	BB		CB		DB
-	//	RR		BC		CC		DC
-	//	RRC		BD		CD		DD
-	//	RL		BE		CE		DE
-	//	RLC		BF		CF		DF
-	int ok = chkargs( op, args, num );
-	if ( ok )
+	if ( arg.undef )
+		return;
+	switch ( arg.type )
 	{
-		switch( args[0].type )
-		{
-		case ARG_A:
-			instr.push_back( 0xB0 | bits );
-			break;
-		case ARG_B:
-			instr.push_back( 0xC0 | bits );
-			break;
-		case ARG_REG:
-			instr.push_back( 0xD0 | bits );
-			instr.push_back( getnum( args[0] ) );
-			break;
-		default:
-			log.error( "Bad arg: %s [%s] (%s)", op.data(), args[0].str.data(), ArgTypes::get(args[0].type) );
-		}
+	case ARG_REG:
+	case ARG_INDIR:
+		if ( !Cpu::isregister( arg.data ) )
+			log.error( "Register not in the register file of %s: [%s]=%d", cpumodel->name, arg.getstr().data(), arg.data );
+		break;
+	case ARG_PORT:
+		if ( !Cpu::isonchip( arg.data - 0x100 ) )
+			log.warn( "Port off-chip on %s: [%s]=%d", cpumodel->name, arg.getstr().data(), arg.data - 0x100 );
+		break;
+	default:
+		break;
 	}
-	return ok;
 }
 
-bool ass_binop( const string op, vector< Arg > &args, int num, int bits, vector< byte > &instr )
+template< class Cpu >
+void emitencoded( instr_t &instr, const Emit &emit, const args_t &args )
 {
-	//			Rn,A	%n,A	Rn,B	Rn,Rn	%n,B	B,A		%n,R
-	// 	AND		13		23		33		43		53		63		73
-	// 	OR		14		24		34		44		54		64		74
-	// 	XOR		15		25		35		45		55		65		75
-	//	BTJO	16		26		36		46		56		66		76
-	//	BTJZ	17		27		37		47		57		67		77
-	//	ADD		18		28		38		48		58		68		78
-	//	ADC		19		29		39		49		59		69		79
-	//	SUB		1A		2A		3A		4A		5A		6A		7A
-	//	SBB		1B		2B		3B		4B		5B		6B		7B
-	//	MPY		1C		2C		3C		4C		5C		6C		7C
-	//	CMP		1D		2D		3D		4D		5D		6D		7D
-	//	DAC		1E		2E		3E		4E		5E		6E		7E
-	//	DSB		1F		2F		3F		4F		5F		6F		7F
-	bool ok = chkargs( op, args, num );
-	if ( ok )
+	switch ( emit.kind )
 	{
-		switch( enum_pair( args[0].type, args[1].type ) )
-		{
-		case enum_pair( ARG_REG, ARG_A ):
-			instr.push_back( 0x10 | bits );
-			instr.push_back( getnum( args[0] ) );
-			break;
-		case enum_pair( ARG_IMM, ARG_A ):
-			instr.push_back( 0x20 | bits );
-			instr.push_back( getnum( args[0] ) );
-			break;
-		case enum_pair( ARG_REG, ARG_B ):
-			instr.push_back( 0x30 | bits );
-			instr.push_back( getnum( args[0] ) );
-			break;
-		case enum_pair( ARG_REG, ARG_REG ):
-			instr.push_back( 0x40 | bits );
-			instr.push_back( getnum( args[0] ) );
-			instr.push_back( getnum( args[1] ) );
-			break;
-		case enum_pair( ARG_IMM, ARG_B ):
-			instr.push_back( 0x50 | bits );
-			instr.push_back( getnum( args[0] ) );
-			break;
-		case enum_pair( ARG_B, ARG_A ):
-			instr.push_back( 0x60 | bits );
-			break;
-		case enum_pair( ARG_IMM, ARG_REG ):
-			instr.push_back( 0x70 | bits );
-			instr.push_back( getnum( args[0] ) );
-			instr.push_back( getnum( args[1] ) );
-			break;
-		default:
-			log.error( "Bad arg(s): %s %s,%s (%s,%s)",
-				op.data(), args[0].str.data(), args[1].str.data(), ArgTypes::get(args[0].type), ArgTypes::get(args[1].type) );
-		}
+	case EMIT_NUM:
+		if ( Cpu::CHECKED )
+			checkoperand< Cpu >( args[emit.arg] );
+		emitnum( instr, args[emit.arg] );
+		break;
+	case EMIT_BYTE:
+		emitbyte( instr, args[emit.arg] );
+		break;
+	case EMIT_WORD:
+		emitword( instr, args[emit.arg] );
+		break;
+	case EMIT_REL:
+		emitoffset( instr, pc+instr.size()+1, args[emit.arg] );
+		break;
+	default:
+		break;
 	}
-	return ok;
 }
 
-bool ass_binop_p( const string op, vector< Arg > &args, int num, int bits, vector< byte > &instr )
+// Assembles an instruction from its encoding (Encodings.h) for the types of
+// its operands, checking them for the CPU variant (Cpu.h).
+template< class Cpu >
+void encode( const string &op, const Opcode &opcode, args_t &args, instr_t &instr )
 {
-	//			A,Pn	B,Pn	%n,Pn
-	// 	ANDP	83		93		A3
-	// 	ORP		84		94		A4
-	// 	XORP	85		95		A5
-	//	BTJOP	86		96		A6
-	//	BTJZP	87		97		A7
-	bool ok = chkargs( op, args, num );
-	if ( ok )
+	if ( !chkargs( op, args, opcode.nargs ) )
+		return;
+
+	size_t keyargs = Encodings::keyargs( opcode );
+	ArgType type0 = keyargs > 0 ? args[0].type : ARG_NONE;
+	ArgType type1 = keyargs > 1 ? args[1].type : ARG_NONE;
+	const Encoding *enc = Encodings::find( opcode, type0, type1 );
+
+	if ( !enc || ( enc->flags & ENC_DEFAULT ) )
 	{
-		switch( enum_pair( args[0].type, args[1].type ) )
-		{
-		case enum_pair( ARG_A, ARG_PORT ):
-			instr.push_back( 0x80 | bits );
-			instr.push_back( getnum( args[1] ) );
-			break;
-		case enum_pair( ARG_B, ARG_PORT ):
-			instr.push_back( 0x90 | bits );
-			instr.push_back( getnum( args[1] ) );
-			break;
-		case enum_pair( ARG_IMM, ARG_PORT ):
-			instr.push_back( 0xA0 | bits );
-			instr.push_back( getbyte( args[0] ) );
-			instr.push_back( getnum( args[1] ) );
-			break;
-		default:
+		if ( keyargs > 1 )
 			log.error( "Bad arg(s): %s %s,%s (%s,%s)",
-				op.data(), args[0].str.data(), args[1].str.data(), ArgTypes::get(args[0].type), ArgTypes::get(args[1].type) );
-		}
+				op.data(), args[0].getstr().data(), args[1].getstr().data(), ArgTypes::get(args[0].type), ArgTypes::get(args[1].type) );
+		else
+			log.error( "Bad arg: %s [%s] (%s)", op.data(), args[0].getstr().data(), ArgTypes::get(args[0].type) );
+	}
+	else if ( ( enc->flags & ENC_COMPAT ) && !options.nocompatwarning )
+	{
+		log.warn( "Got type %s, assuming DIR: %s=%04X", ArgTypes::get(args[0].type), args[0].getstr().data(), args[0].data );
 	}
-	return ok;
-}
 
-void ass_jump( const string op, vector< Arg > &args, int bits, vector< byte > &instr )
-{
-	//		JMP		JN/JLT	JZ/JEQ	JC/JHS	JP/JGT	JPZ/JGE	JNZ/JNE	JNC/JL
-	//		E0		E1		E2		E3		E4		E5		E6		E7
-	if ( chkargs( op, args, 1 ) )
+	if ( enc )
 	{
-		switch( args[0].type )
-		{
-		case ARG_IMM:
-			instr.push_back( 0xE0 | bits );
-			instr.push_back( getoffset( pc+2, args[0] ) );
-			break;
-		default:
-			log.error( "Bad arg: %s [%s] (%s)", op.data(), args[0].str.data(), ArgTypes::get(args[0].type) );
-		}
+		instr.push_back( Encodings::opcodebyte( opcode, *enc, keyargs ? args[0].data : 0 ) );
+		emitencoded< Cpu >( instr, enc->emit[0], args );
+		emitencoded< Cpu >( instr, enc->emit[1], args );
 	}
+	if ( opcode.jump )
+		emitoffset( instr, pc+instr.size()+1, args.back() );	// DJNZ, BTJO, BTJZ, BTJOP, BTJZP
 }
 
-void ass_trap( const string op, vector< Arg > &args, vector< byte > &instr )
+typedef void ( *Encoder )( const string &op, const Opcode &opcode, args_t &args, instr_t &instr );
+
+// By CpuVariant.
+const Encoder encoders[CPU_VARIANTS] =
 {
-	//			n
-	//	TRAP	E8+n
-	if ( chkargs( op, args, 1 ) )
-	{
-		switch( args[0].type )
-		{
-		case ARG_IMM:
-			instr.push_back( 0xFF - args[0].data );
-			break;
-		default:
-			log.error( "Bad arg: %s [%s] (%s)", op.data(), args[0].str.data(), ArgTypes::get(args[0].type) );
-		}
-	}
+	encode< CpuGeneric >,
+	encode< Cpu7000 >,
+	encode< Cpu7001 >,
+	encode< Cpu7042 >,
+	encode< Cpu70C42 >
+};
+
+Encoder encoder = encoders[CPU_GENERIC];
+
+// Selects the CPU variant the instructions are encoded for.
+void selectcpu( const CpuModel *model )
+{
+	cpumodel = model;
+	encoder = encoders[model->variant];
 }
 
-void ass_pushpop( const string op, vector< Arg > &args, int bits, vector< byte > &instr )
+// Length of the instruction encode() assembles, from the types of the
+// operands only: pass 1 just needs to advance pc.
+size_t encodedlength( const Opcode &opcode, const args_t &args )
 {
-	//			A		B		REG		ST
-	//	PUSH	B8		C8		D8		0E
-	//	POP		B9		C9		D9		08
-	if ( chkargs( op, args, 1 ) )
+	if ( args.size() != size_t( opcode.nargs ) )
+		return 0;
+
+	size_t keyargs = Encodings::keyargs( opcode );
+	ArgType type0 = keyargs > 0 ? args[0].type : ARG_NONE;
+	ArgType type1 = keyargs > 1 ? args[1].type : ARG_NONE;
+	const Encoding *enc = Encodings::find( opcode, type0, type1 );
+
+	if ( enc )
+		return Encodings::length( opcode, *enc );
+	return opcode.jump ? 1 : 0;
+}
+
+
+// Splits a source line in label, operation and operands, folded to upper
+// case except in quotes (unless -CS) while copied. argstr is kept as written.
+// The tokens are spans of the line and the strings reuse their buffers: no
+// allocation for a typical line.
+void tokenize( const string &line, string &label, string &op, string &argstr, vector< string > &argstrs )
+{
+	bool casesensitive = options.casesensitive;
+
+	StringView spans[Strings::MAXTOKENS];
+	vector< StringView > more;
+
+	// get tokens
+	StringView *tokens = spans;
+	size_t ntokens = Strings::split( line, "\t :", spans, Strings::MAXTOKENS );
+	if ( ntokens > Strings::MAXTOKENS )
+	{
+		more.resize( ntokens );
+		Strings::split( line, "\t :", &more[0], ntokens );
+		tokens = &more[0];
+	}
+
+	label.clear();
+	op.clear();
+	argstr.clear();
+
+	for ( size_t i=0; i<ntokens; ++i )
 	{
-		if ( chkargs( op, args, 1 ) )
+		const StringView &token = tokens[i];
+		if ( !token.empty() && token[0] == ';' )
+		{
+			break;	// comment
+		}
+		else
 		{
-			switch( args[0].type )
+			switch ( i )
 			{
-			case ARG_A:
-				instr.push_back( 0xB0 | bits );
+			case 0:
+				Strings::fold( token, label, casesensitive );
+				if ( !label.empty() && label[label.size()-1] == ':' )
+					label.resize( label.size()-1 );
 				break;
-			case ARG_B:
-				instr.push_back( 0xC0 | bits );
+			case 1:
+				Strings::fold( token, op, casesensitive );
 				break;
-			case ARG_REG:
-				instr.push_back( 0xD0 | bits );
-				instr.push_back( getnum( args[0] ) );
-				break;
-			case ARG_ST:
-				instr.push_back( bits == 0x08 ? 0x0E : 0x08 );
+			case 2:
+				argstr.assign( token.data(), token.size() );
 				break;
 			default:
-				log.error( "Bad arg: %s [%s] (%s)", op.data(), args[0].str.data(), ArgTypes::get(args[0].type) );
+				argstr += ' ';
+				argstr.append( token.data(), token.size() );
+				break;
 			}
 		}
 	}
-}
 
-void ass_implicit( const string op, vector< Arg > &args, int bits, vector< byte > &instr )
-{
-	if ( chkargs( op, args, 0 ) )
+	StringView *args = spans;
+	size_t nargs = Strings::split( argstr, ",", spans, Strings::MAXTOKENS );
+	if ( nargs > Strings::MAXTOKENS )
 	{
-		instr.push_back( bits );
+		more.resize( nargs );
+		Strings::split( argstr, ",", &more[0], nargs );
+		args = &more[0];
 	}
+
+	argstrs.resize( nargs );
+	for ( size_t i=0; i<nargs; ++i )
+		Strings::fold( args[i], argstrs[i], casesensitive );
 }
 
 
@@ -476,7 +447,11 @@ void main( int argc, const char* argp[] )
 	char buf[256];
 	const string stab = "\t";
 
-	string infile, outfile, lstfile;
+	string infile, outfile, lstfile, expfile;
+	string cpuname = "GENERIC";
+	bool onepass = false;
+	bool memstats = false;
+	IncludeGuard includeguard;
 
 	for ( int i=1; i<argc; ++i )
 	{
@@ -503,6 +478,16 @@ void main( int argc, const char* argp[] )
 					++p;
 				lstfile = p;
 				break;
+			case 'P':
+				if ( *p == ':' )
+					++p;
+				includepath.add( p );
+				break;
+			case 'E':
+				if ( *p == ':' )
+					++p;
+				expfile = *p ? p : "-";
+				break;
 			case 'N':
 				c = toupper( *p );
 				++p;
@@ -523,11 +508,33 @@ void main( int argc, const char* argp[] )
 				case 'N':
 					options.nolinenum = ( *p != '-' );
 					break;
+				case 'R':
+					includeguard.setAll( *p != '-' );
+					break;
 				case 'W':
 					options.nowarning = ( *p != '-' );
 					break;
 				}
 				break;
+			case 'C':
+				if ( toupper( *p ) == 'S' )
+				{
+					options.casesensitive = ( p[1] != '-' );
+				}
+				else if ( toupper( p[0] ) == 'P' && toupper( p[1] ) == 'U' )
+				{
+					p += 2;
+					if ( *p == ':' )
+						++p;
+					cpuname = Strings::touppernotquoted( p );
+				}
+				break;
+			case '1':
+				onepass = true;
+				break;
+			case 'M':
+				memstats = true;
+				break;
 			case '?':
 				cerr << help << endl;
 				exit( 0 );
@@ -536,23 +543,61 @@ void main( int argc, const char* argp[] )
 		}
 	}
 
-	if 	( !infile.empty() && infile.find( "." ) == string::npos )
+	const string stdio = "-";	// standard input or output
+
+	if 	( !infile.empty() && infile != stdio && infile.find( "." ) == string::npos )
 	{
 		infile += ".asm";
 	}
 
-	if 	( !outfile.empty() && outfile.find( "." ) == string::npos )
+	if 	( !outfile.empty() && outfile != stdio && outfile.find( "." ) == string::npos )
 	{
 		outfile += ".cim";
 	}
 
-	if 	( !lstfile.empty() && lstfile.find( "." ) == string::npos )
+	if 	( !lstfile.empty() && lstfile != stdio && lstfile.find( "." ) == string::npos )
 	{
 		lstfile += ".lst";
 	}
 
+	if 	( !expfile.empty() && expfile != stdio && Strings::extension( expfile ) == string::npos )
+	{
+		expfile += ".i";
+	}
+
+	if ( !expfile.empty() )
+	{
+		// preprocess only: no object output
+		outfile.clear();
+	}
+
+	if ( ( outfile == stdio && lstfile == stdio )
+		|| ( expfile == stdio && lstfile == stdio ) )
+	{
+		cerr << "Output and listing can't both go to standard output" << endl;
+		exit( 1 );
+	}
+
+	// line origins of the expanded source: next to it, else to the input
+	string locfile = expfile == stdio ? infile : expfile;
+	if ( locfile == stdio )
+	{
+		cerr << "Line origins need a file: -E:expanded or -I:inputfile" << endl;
+		exit( 1 );
+	}
+	if ( !locfile.empty() )
+		locfile = locfile.substr( 0, Strings::extension( locfile ) ) + ".loc";
 
-	Source in( infile );
+	const CpuModel *cpu = Cpus::find( cpuname );
+
+	if ( !cpu )
+	{
+		cerr << "Unknown CPU [" << cpuname << "]" << endl;
+		exit( 1 );
+	}
+
+	// standard input is spooled in memory for pass 2
+	Source in = infile == stdio ? Source( "stdin", cin ) : Source( infile );
 
 	if ( !in )
 	{
@@ -560,22 +605,56 @@ void main( int argc, const char* argp[] )
 		exit( 1 );
 	}
 
-	ofstream out;
+	// load the include files in the background
+	prefetcher.prefetch( infile );
 
-	if ( !outfile.empty() )
+	ofstream outf;
+	ostream *out = 0;
+
+	if ( outfile == stdio )
+	{
+#ifdef _WIN32
+		_setmode( _fileno( stdout ), _O_BINARY );
+#endif
+		out = &cout;
+	}
+	else if ( !outfile.empty() )
 	{
-			out.open( outfile.data(), ios::binary );
+		outf.open( outfile.data(), ios::binary );
 
-		if ( !out )
+		if ( !outf )
 		{
 			cerr << "Failed to open output file [" << outfile << "]" << endl;
 			exit( 1 );
 		}
+
+		out = &outf;
+	}
+
+	ofstream expf;
+	ExpandedSource expanded;
+
+	if ( expfile == stdio )
+	{
+		expanded.setOutput( &cout );
+	}
+	else if ( !expfile.empty() )
+	{
+		expf.open( expfile.data(), ios::binary );
+
+		if ( !expf )
+		{
+			cerr << "Failed to open expanded source file [" << expfile << "]" << endl;
+			exit( 1 );
+		}
+
+		expanded.setOutput( &expf );
 	}
 
 	ofstream lst;
+	ostream nolst( 0 );	// discarded listing when the output goes to stdout
 
-	if ( !lstfile.empty() )
+	if ( !lstfile.empty() && lstfile != stdio )
 	{
 		lst.open( lstfile.data(), ios::binary );
 
@@ -586,7 +665,8 @@ void main( int argc, const char* argp[] )
 		}
 	}
 
-	ostream &ostr = !lstfile.empty() ? lst : cout;
+	ostream &ostr = !lstfile.empty() && lstfile != stdio ? lst
+		: out == &cout || expfile == stdio ? nolst : cout;
 
 	if ( !options.noheader )
 	{
@@ -604,42 +684,43 @@ void main( int argc, const char* argp[] )
 
 	symbols.beginSymbols();
 
-	for ( int i=0; i<0x100; ++i )
-	{
-		stringstream sstr;
-		sstr << "R" << i;
-		string label = sstr.str();
-		Arg arg = { ARG_REG, i, label, "" };
-		symbols.addSymbol( label, arg );
-	}
-
-	for ( int i=0; i<0x100; ++i )
-	{
-		stringstream sstr;
-		sstr << "P" << i;
-		string label = sstr.str();
-		Arg arg = { ARG_PORT, i + 0x100, label, "" };
-		symbols.addSymbol( label, arg );
-	}
-
-	Arg argDate = { ARG_TEXT, 0, "DATE", "DD-MM-YYYY" };
+	Arg argDate = { ARG_TEXT, 0, stringpool.intern( "DATE" ), stringpool.intern( "DD-MM-YYYY" ), 0 };
 	symbols.addSymbol( "DATE", argDate );
 
-	Arg argTime = { ARG_TEXT, 0, "DATE", "HH:MM:SS" };
+	Arg argTime = { ARG_TEXT, 0, stringpool.intern( "DATE" ), stringpool.intern( "HH:MM:SS" ), 0 };
 	symbols.addSymbol( "TIME", argTime );
 
 
-	for ( pass=1; pass<=2; ++pass )
+	LineIR ir;
+
+	// single pass: fixups patched in the image, written at the end
+	vector< byte > image;
+	fixups.setEnabled( onepass );
+
+	// containers of a line, freed at once when the next line starts
+	Arena arena;
+	stringstream listline;
+
+	for ( pass = onepass ? 2 : 1; pass<=2; ++pass )
 	{
 		log.setEnabled( pass == 2 );
 		log.setDebug( !options.nodebug );
 		log.setWarning( !options.nowarning );
 
 		cerr << "Pass: " << pass << endl;
+		size_t arenastart = arena.allocations();
+		size_t linestart = arena.resets();
 		pc = 0;
+		selectcpu( cpu );
 		bool end = false;
 
-		in.rewind();
+		// pass 2 replays the lines tokenized by pass 1
+		bool replay = ir.recorded();
+
+		if ( replay )
+			ir.rewind();
+		else
+			in.rewind();
 
 		int errcount = 0;
 		int warncount = 0;
@@ -650,25 +731,58 @@ void main( int argc, const char* argp[] )
 #endif
 
 		stack< Source > sources;
+		stack< string > names;	// replay: names of the sources being read
+		stack< const FileData* > files;	// contents of the included files, 0 for REPT
 		stack< int > conditions;
+		stack< LineOrigin > origins;	// -E: file and line of the lines read
+		size_t reptline = 0;			// -E: file line of the REPT being defined
 		bool condit = true;
 
+		names.push( in.getname() );
+		LineOrigin input = { in.getname(), 0, 0, 0 };
+		origins.push( input );
+		files.push( infile == stdio ? 0 : sourcecache.get( infile ) );
+
+		includeguard.clear();
+		includeguard.included( files.top() );
+
 		functions.clear();
+		expressions.clearFunctions();
+
+		string line, label, op, argstr;
+		vector< string > argstrs;
 
 		while( true )
 		{
-			string 	line = in.getline();
+			if ( replay && ir.eof() )
+				break;
+
+			const IRLine *irline = replay ? &ir.next() : 0;
+
+			arena.reset();
+
+			if ( !replay )
+			{
+				StringView view = in.getlineview();
+				line.assign( view.data(), view.size() );
+			}
 
-			bool isline = in;
+			bool isline = replay ? bool( irline->flags & IRLine::ISLINE ) : bool( in );
 
 			if ( !isline )
 			{
-				if (!sources.empty() )
+				if ( names.size() > 1 )
 				{
 					//log.info( "END INCLUDE" );
-					in = sources.top();
-					log.info( "File: %s ***", in.getname().data() );
-					sources.pop();
+					if ( !replay )
+					{
+						in = sources.top();
+						sources.pop();
+					}
+					names.pop();
+					files.pop();
+					origins.pop();
+					log.info( "File: %s ***", names.top().data() );
 					symbols.endSymbols();
 				}
 				else
@@ -678,90 +792,135 @@ void main( int argc, const char* argp[] )
 				}
 			}
 
-			int num = in.linenum();
+			int num = replay ? irline->num : in.linenum();
+			size_t origin = isline ? origins.top().next( num ) : num;
 
-			vector< string > tokens = Strings::split( line, "\t :" );
+			bool filtered = false;
+			bool recorded = false;	// replay of a line tokenized by pass 1
 
-			// get tokens
-			string label, op, comment, argstr;
-
-
-			for ( int i=0; i<tokens.size(); ++i )
+			if ( replay )
 			{
-				const string token = tokens[i];
-				if ( token[0] == ';' )
+				ir.get( *irline, line, label, op, argstr, argstrs );
+#if MACRO
+				if ( ( irline->flags & IRLine::FILTERED ) && ( condit || macro ) )
+#else
+				if ( ( irline->flags & IRLine::FILTERED ) && condit )
+#endif
+					tokenize( line, label, op, argstr, argstrs );	// skipped by pass 1 only
+				else
+					recorded = true;
+			}
+			else
+			{
+				if ( LineFilter::isblank( line ) )
 				{
-					comment = token;
-					break;
+					label.clear();
+					op.clear();
+					argstr.clear();
+					argstrs.clear();
+				}
+#if MACRO
+				else if ( !condit && !macro && LineFilter::isinactive( line ) )
+#else
+				else if ( !condit && LineFilter::isinactive( line ) )
+#endif
+				{
+					// false conditional block: not tokenized
+					label.clear();
+					op.clear();
+					argstr.clear();
+					argstrs.clear();
+					filtered = true;
 				}
 				else
 				{
-					switch ( i )
-					{
-					case 0:
-						label = Strings::touppernotquoted( token );
-						if ( !label.empty() && label[label.size()-1] == ':' )
-							label = label.substr( 0, label.size()-1 );
-						break;
-					case 1:
-						op = Strings::touppernotquoted( token );
-						break;
-					case 2:
-						argstr = token;
-						break;
-					default:
-						argstr += " " + token;
-						break;
-					}
+					tokenize( line, label, op, argstr, argstrs );
+				}
+
+				if ( pass == 1 )
+				{
+					ir.add( line, num, isline, label, op, argstr, argstrs );
+					if ( filtered )
+						ir.back().flags |= IRLine::FILTERED;
 				}
 			}
 
-			vector< string > argstrs = Strings::split( argstr, "," );
 			size_t nargs = argstrs.size();
 
+			// O(1) dispatch on the operation, looked up once by pass 1
+			const Opcode *opcode = recorded ? irline->opcode : Opcodes::find( op );
+			OpHandler handler = recorded ? irline->handler : Opcodes::handler( op, opcode );
+			if ( pass == 1 )
+			{
+				ir.back().opcode = opcode;
+				ir.back().handler = handler;
+			}
+			bool pushed = false;
+
+			fixups.clearLine();
+
 			word addr = pc;
-			vector< byte > instr;
+			instr_t instr( arena );
+			size_t sized = 0;	// pass 1: length of the line, instr left empty
 
 			bool outaddr = false;
 			bool listblock = true;
 			bool oldcond = condit;
 
+			// -E: the line goes to the expanded source, unless it is a
+			// preprocessing directive
+			bool expandline = expanded.isEnabled() && pass == 2 && isline && condit;
+
 #if MACRO
 			if ( macro )
 			{
 				CDBG << "if ( macro ) ok" << endl;
+				expandline = false;
 				if ( !macro.add( op, line ) )
 				{
 					CDBG << "if ( !macro.add() ) ok" << endl;
 					if ( macro.gettype() == "REPT" )
 					{
 						CDBG << "macro rept push" << endl;
-						Arg arg = Parser::getarg( Strings::touppernotquoted( macro.args() ) );
-						macro.rept( arg.data );
-						sources.push( in );
-						in = Source( "REPT", macro );
+						if ( !replay )
+						{
+							string count;
+							Strings::fold( macro.args(), count, options.casesensitive );
+							Arg arg = Parser::getarg( count );
+							macro.rept( arg.data );
+							sources.push( in );
+							in = Source( "REPT", macro );
+						}
+						names.push( "REPT" );
+						files.push( 0 );
+						LineOrigin rept = { origins.top().name, reptline + 1, macro.size(), 0 };
+						origins.push( rept );
+						pushed = true;
 						symbols.beginSymbols();
-						log.info( "Macro: %s ***", in.getname().data() );
+						log.info( "Macro: %s ***", names.top().data() );
 					}
 				}
 				CDBG << "if ( macro ) ok" << endl;
 			}
-			else if ( op == "REPT" )
+			else if ( handler == OP_REPT )
 			{
 				CDBG << "if ( op == REPT )" << endl;
 				macro = Macro( "REPT", "REPT", argstr );
+				reptline = origin;
+				expandline = false;
 				CDBG << "if ( op == REPT )" << endl;
 			}
 			else
 #endif
-			if ( op == "IF" || op == "$IF" || op == "COND" )
+			if ( handler == OP_IF )
 			{
+				expandline = false;
 				conditions.push( condit );
 				if ( nargs == 1 )
 				{
 					if ( condit )
 					{
-						Arg arg = Parser::getarg( Strings::touppernotquoted( argstrs[0] ) );
+						Arg arg = Parser::getarg( argstrs[0] );
 						condit = bool( arg.data );
 					}
 				}
@@ -774,8 +933,9 @@ void main( int argc, const char* argp[] )
 					log.error( "IF: too many argument" );
 				}
 			}
-			else if ( op == "ELSE" || op == "$ELSE" )
+			else if ( handler == OP_ELSE )
 			{
+				expandline = false;
 				if ( !conditions.empty() )
 				{
 					if ( nargs == 0 )
@@ -792,8 +952,9 @@ void main( int argc, const char* argp[] )
 					log.error( "ELSE without IF" );
 				}
 			}
-			else if ( op == "ENDIF" || op == "$ENDIF" || op == "$ENDC" )
+			else if ( handler == OP_ENDIF )
 			{
+				expandline = false;
 				if ( !conditions.empty() )
 				{
 					if ( nargs == 0 )
@@ -814,35 +975,70 @@ void main( int argc, const char* argp[] )
 			else if ( condit )
 			{
 
-				if ( op == "COPY" || op == "INCLUDE" || op == "GET" )
+				switch ( handler )
 				{
+				case OP_INCLUDE:
 					if ( nargs == 1 )
 					{
-						sources.push( in );
-						in = Source( argstrs[0] );
-						if ( in )
+						// single arg: argstr is the file name, not folded to upper case
+						const FileData *data = 0;
+						bool found, skipped;
+						if ( replay )
+						{
+							found = !( irline->flags & IRLine::NOFILE );
+							skipped = bool( irline->flags & IRLine::SKIPPED );
+						}
+						else
 						{
-							log.info( "File: %s ***", in.getname().data() );
+							string path = includepath.find( argstr );
+							data = sourcecache.get( path );
+							found = data;
+							skipped = includeguard.skip( data );
+							if ( found && !skipped )
+							{
+								sources.push( in );
+								in = Source( path, data );
+								includeguard.included( data );
+							}
+							if ( pass == 1 )
+								ir.back().flags |= ( found ? 0 : IRLine::NOFILE ) | ( skipped ? IRLine::SKIPPED : 0 );
+						}
+
+						if ( found )
+							expandline = false;
+
+						if ( skipped )
+						{
+							log.info( "File: %s already included ***", argstr.data() );
+						}
+						else if ( found )
+						{
+							names.push( argstr );
+							files.push( data );
+							LineOrigin include = { argstr, 0, 0, 0 };
+							origins.push( include );
+							pushed = true;
+							log.info( "File: %s ***", argstr.data() );
 							symbols.beginSymbols();
 						}
 						else
 						{
-							log.error( "Can't open include file %s", argstrs[0].data() );
-							in = sources.top();
-							sources.pop();
+							log.error( "Can't open include file %s", argstr.data() );
 						}
 					}
 					else
 					{
 						log.error( "Expecting 1 arg %s", argstr.data() );
 					}
-				}
-				else if ( op == "SAVE" )
-				{
+					break;
+				case OP_ONCE:
+					expandline = false;
+					includeguard.once( files.top() );
+					break;
+				case OP_SAVE:
 					optstack.push( options );
-				}
-				else if ( op == "RESTORE" )
-				{
+					break;
+				case OP_RESTORE:
 					if ( optstack.empty() )
 					{
 						log.error( "No saved options" );
@@ -852,37 +1048,44 @@ void main( int argc, const char* argp[] )
 						options = optstack.top();
 						optstack.pop();
 					}
-				}
-				else if ( op == "CPU" )
-				{
-					log.debug( "%s %s ignored", op.data(), argstr.data() );
-				}
-				else if ( op == "PAGE" )
-				{
+					break;
+				case OP_CPU:	// CPU name
 					if ( nargs == 1 )
 					{
-						string arg = Strings::touppernotquoted( argstrs[0] );
+						const CpuModel *model = Cpus::find( argstrs[0] );
+						if ( model )
+							selectcpu( model );
+						else
+							log.error( "Unknown CPU: %s", argstrs[0].data() );
+					}
+					else
+					{
+						log.error( "Expecting 1 arg %s", argstr.data() );
+					}
+					break;
+				case OP_PAGE:
+					if ( nargs == 1 )
+					{
+						const string &arg = argstrs[0];
 						options.page = arg == "ON" || arg == "1";
 					}
 					else
 					{
 						log.error( "Expecting 1 arg %s", argstr.data() );
 					}
-				}
-				else if ( op == "LISTING" )
-				{
+					break;
+				case OP_LISTING:
 					if ( nargs == 1 )
 					{
-						string arg = Strings::touppernotquoted( argstrs[0] );
+						const string &arg = argstrs[0];
 						options.list = arg == "ON" || arg == "1";
 					}
 					else
 					{
 						log.error( "Expecting 1 arg %s", argstr.data() );
 					}
-				}
-				else if ( op == "FUNCTION" || op == "FUNC" )
-				{
+					break;
+				case OP_FUNCTION:
 					if ( nargs == 0 )
 					{
 						log.error( "Missing arg %s", argstr.data() );
@@ -899,34 +1102,46 @@ void main( int argc, const char* argp[] )
 					{
 						Function func( label, argstrs );
 						functions[label] = func;
+						expressions.define( label, func.params_, Parser( func.expr_ ).compile() );
 					}
-				}
-				else if ( op == "MACRO" )
-				{
+					break;
+				case OP_MACRO:
 					log.warn( "%s %s currently not handled", op.data(), argstr.data() );
-				}
-				else
+					break;
+				default:
 				{
-					vector< Arg > args( nargs );
+					args_t args( nargs, Arg(), arena );
 					for ( int i=0; i<nargs; ++i )
 					{
-						args[i] = Parser::getarg( Strings::touppernotquoted( argstrs[i] ) );
+						if ( recorded )
+						{
+							args[i] = Parser::getarg( argstrs[i], ir.operand( *irline, i ).id );
+						}
+						else if ( pass == 1 )
+						{
+							IROperand &arg = ir.operand( ir.back(), i );
+							args[i] = Parser::getarg( argstrs[i], arg.id );
+							arg.type = args[i].type;
+						}
+						else
+						{
+							args[i] = Parser::getarg( argstrs[i] );
+						}
 					}
 
 					ArgType type = ARG_IMM;
 
 					if ( !label.empty() )
 					{
-						if ( op == "AORG" || op == "ORG" )
+						if ( handler == OP_ORG )
 						{
 							if ( chkargs( op, args, 1 ) )
 							{
 								addr = getimmediate( args[0] );
-								if ( op == "AORG" || op == "ORG" )
-									pc = addr;
+								pc = addr;
 							}
 						}
-						else if ( op == "EQU" )
+						else if ( handler == OP_EQU )
 						{
 							if ( chkargs( op, args, 1 ) )
 							{
@@ -937,10 +1152,10 @@ void main( int argc, const char* argp[] )
 								case ARG_PORT:
 									addr = args[0].data;
 									type = args[0].type;
-									//log.error( "debug: set [%s] (%s=%04x)", args[0].str.data(), ArgTypes::get(type], addr );
+									//log.error( "debug: set [%s] (%s=%04x)", args[0].getstr().data(), ArgTypes::get(type], addr );
 									break;
 								default:
-									log.error( "Bad addressing mode: [%s] (%s)", args[0].str.data(), ArgTypes::get(args[0].type) );
+									log.error( "Bad addressing mode: [%s] (%s)", args[0].getstr().data(), ArgTypes::get(args[0].type) );
 								}
 							}
 						}
@@ -952,8 +1167,11 @@ void main( int argc, const char* argp[] )
 								log.error ( "Multiple definition: [%s] (%s=%04X)",
 									label.data(), ArgTypes::get(sym.type), sym.data );
 						}
-						Arg arg = { type, addr, label, "" };
+						Arg arg = { type, addr, stringpool.intern( label ), 0, 0 };
 						symbols.addSymbol( label, arg );
+
+						if ( fixups.isEnabled() )
+							resolvefixups( label, image );
 					}
 
 
@@ -961,9 +1179,10 @@ void main( int argc, const char* argp[] )
 
 					outaddr = true;
 
-					// ============= AORG
-					if ( op == "AORG" || op == "ORG" )	// AORG aaaa
+					switch ( handler )
 					{
+					// ============= AORG
+					case OP_ORG:	// AORG aaaa
 						if ( label.empty() )
 						{
 							if ( chkargs( op, args, 1 ) )
@@ -971,284 +1190,39 @@ void main( int argc, const char* argp[] )
 								addr = pc = getimmediate( args[0] );
 							}
 						}
-					}
-					// ============= MOVE
-					else if ( op == "MOV" ) // MOV ss,dd
-					{
-						ass_mov( op, args, instr );
-					}
-					else if ( op == "MOVD" ) // MOVD ssss,dddd
-					{
-						ass_movd( op, args, instr );
-					}
-					else if ( op == "MOVP" ) // MOVP ss,dd
-					{
-						ass_movp( op, args, instr );
-					}
-					// ============= MEMORY ACCESS
-					else if ( op == "LDA" ) // LDA @aaaa[(B)],dd
-					{
-						ass_xaddr( op, args, 0x0A, instr );
-					}
-					else if ( op == "STA" ) // STA dd,@aaaa[(B)]
-					{
-						ass_xaddr( op, args, 0x0B, instr );
-					}
-					else if ( op == "BR" ) // BR @aaaa[(B)] (long jump)
-					{
-						ass_xaddr( op, args, 0x0C, instr );
-					}
-					else if ( op == "CMPA" ) // CMPA @aaaa[(B)]
-					{
-						ass_xaddr( op, args, 0x0D, instr );
-					}
-					else if ( op == "CALL" ) // CALL aaaa
-					{
-						ass_xaddr( op, args, 0x0E, instr );
-					}
-					// ============= IMPLICIT (no operands)
-					else if ( op == "NOP"  )  // NOP
-					{
-						ass_implicit( op, args, 0x00, instr );
-					}
-					else if ( op == "IDLE"  ) // IDLE
-					{
-						ass_implicit( op, args, 0x01, instr );
-					}
-					else if ( op == "EINT" ) // EINT
-					{
-						ass_implicit( op, args, 0x05, instr );
-					}
-					else if ( op == "DINT" ) // DINT
-					{
-						ass_implicit( op, args, 0x06, instr );
-					}
-					else if ( op == "SETC" ) // SETC
-					{
-						ass_implicit( op, args, 0x07, instr );
-					}
-					else if ( op == "STSP" ) // STSP
-					{
-						ass_implicit( op, args, 0x09, instr );
-					}
-					else if ( op == "RETS" ) // RETS (from subroutine)
-					{
-						ass_implicit( op, args, 0x0A, instr );
-					}
-					else if ( op == "RETI" ) // RETI (from interrupt)
-					{
-						ass_implicit( op, args, 0x0B, instr );
-					}
-					else if ( op == "LDSP" ) // LDSP
-					{
-						ass_implicit( op, args, 0x0D, instr );
-					}
-					else if ( op == "TSTA" || op == "CLRC" ) // TSTA/CLRC
-					{
-						ass_implicit( op, args, 0xB0, instr );
-					}
-					else if ( op == "TSTB" ) // TSTB
-					{
-						ass_implicit( op, args, 0xC1, instr );
-					}
-					// ============= UNARY OPS
-					else if ( op == "DEC"  ) // DEC xx
-					{
-						ass_unop( op, args, 1, 0x02, instr );
-					}
-					else if ( op == "INC"  ) // INC xx
-					{
-						ass_unop( op, args, 1, 0x03, instr );
-					}
-					else if ( op == "INV"  ) // INV xx
-					{
-						ass_unop( op, args, 1, 0x04, instr );
-					}
-					else if ( op == "CLR"  ) // CLR xx
-					{
-						ass_unop( op, args, 1, 0x05, instr );
-					}
-					else if ( op == "XCHB" ) // XCHB xx
-					{
-						ass_unop( op, args, 1, 0x06, instr );
-					}
-					else if ( op == "SWAP" ) // SWAP xx
-					{
-						ass_unop( op, args, 1, 0x07, instr );
-					}
-					else if ( op == "DECD" ) // DECD Rnn
-					{
-						ass_unop( op, args, 1, 0x0B, instr );
-					}
-					else if ( op == "RR"   ) // RR xx
-					{
-						ass_unop( op, args, 1, 0x0C, instr );
-					}
-					else if ( op == "RRC"  ) // RRC xx
-					{
-						ass_unop( op, args, 1, 0x0D, instr );
-					}
-					else if ( op == "RL"   ) // RL xx
-					{
-						ass_unop( op, args, 1, 0x0E, instr );
-					}
-					else if ( op == "RLC"  ) // RLC xx
-					{
-						ass_unop( op, args, 1, 0x0F, instr );
-					}
-					// ============= BINARY OPERATIONS
-					else if ( op == "AND" ) // AND yy,xx
-					{
-						ass_binop( op, args, 2, 0x03, instr );
-					}
-					else if ( op == "OR"  ) // OR yy,xx
-					{
-						ass_binop( op, args, 2, 0x04, instr );
-					}
-					else if ( op == "XOR" ) // XOR yy,xx
-					{
-						ass_binop( op, args, 2, 0x05, instr );
-					}
-					else if ( op == "ADD" ) // ADD yy,xx
-					{
-						ass_binop( op, args, 2, 0x08, instr );
-					}
-					else if ( op == "ADC" ) // ADC yy,xx
-					{
-						ass_binop( op, args, 2, 0x09, instr );
-					}
-					else if ( op == "SUB" ) // SUB yy,xx
-					{
-						ass_binop( op, args, 2, 0x0A, instr );
-					}
-					else if ( op == "SBB" ) // SBB yy,xx
-					{
-						ass_binop( op, args, 2, 0x0B, instr );
-					}
-					else if ( op == "MPY" ) // MPY yy,xx
-					{
-						ass_binop( op, args, 2, 0x0C, instr );
-					}
-					else if ( op == "CMP" ) // CMP yy,xx
-					{
-						ass_binop( op, args, 2, 0x0D, instr );
-					}
-					else if ( op == "DAC" ) // DAC yy,xx
-					{
-						ass_binop( op, args, 2, 0x0E, instr );
-					}
-					else if ( op == "DSB" ) // DSB yy,xx
-					{
-						ass_binop( op, args, 2, 0x0F, instr );
-					}
-					// ============= BINARY OPERATIONS ON PORTS
-					else if ( op == "ANDP" ) // ANDP yy,Pnn
-					{
-						ass_binop_p( op, args, 2, 0x03, instr );
-					}
-					else if ( op == "ORP" ) // ORP yy,Pnn
-					{
-						ass_binop_p( op, args, 2, 0x04, instr );
-					}
-					else if ( op == "XORP" ) // ORP yy,Pnn
-					{
-						ass_binop_p( op, args, 2, 0x05, instr );
-					}
-					// ============= SHORT JUMPS
-					else if ( op == "JMP" )                // JMP aaaa
-					{
-						ass_jump( op, args, 0x00, instr );
-					}
-					else if ( op == "JN" || op == "JLT"  ) // JN/LT aaaa (jump if negative/less than)
-					{
-						ass_jump( op, args, 0x01, instr );
-					}
-					else if ( op == "JZ" || op == "JEQ"  ) // JZ/JEQ aaaa (jump if zero/equal)
-					{
-						ass_jump( op, args, 0x02, instr );
-					}
-					else if ( op == "JC" || op == "JHS"  ) // JC/?JHS aaaa (jump if carry/?higher or same)
-					{
-						ass_jump( op, args, 0x03, instr );
-					}
-					else if ( op == "JP" || op == "JGT"  ) // JP/JGT aaaa (jump if positive/greater than)
-					{
-						ass_jump( op, args, 0x04, instr );
-					}
-					else if ( op == "JPZ" || op == "JGE" ) // JPZ/JGE aaaa (jump if positive or zero/greater or equal)
-					{
-						ass_jump( op, args, 0x05, instr );
-					}
-					else if ( op == "JNZ" || op == "JNE" ) // JNZ/JNZ aaaa (jump if !zero/!equal)
-					{
-						ass_jump( op, args, 0x06, instr );
-					}
-					else if ( op == "JNC" || op == "JL"  ) // JNC/JL aaaa (jump if !carry/?lower)
-					{
-						ass_jump( op, args, 0x07, instr );
-					}
-					else if ( op == "DJNZ" ) 			   // DJNZ R,aaaa (jump if !carry/?lower)
-					{
-						if ( ass_unop( op, args, 2, 0x0A, instr ) )
-						{
-							instr.push_back( getoffset( pc+instr.size()+1, args[1] ) );
-						}
-					}
-					// ============= BIT TESTS & SHORT JUMPS
-					else if ( op == "BTJO" ) // BTJO %yy,xx,aaaa (jump if any bit of xx masked by %yy is one)
-					{
-						if ( ass_binop( op, args, 3, 0x06, instr ) )
-						{
-							instr.push_back( getoffset( pc+instr.size()+1, args[2] ) );
-						}
-					}
-					else if ( op == "BTJOP" ) // BTJOP %yy,Pnn,aaaa (jump if any bit of Pnn masked by %yy is one)
-					{
-						if ( ass_binop_p( op, args, 3, 0x06, instr ) )
-						{
-							instr.push_back( getoffset( pc+instr.size()+1, args[2] ) );
-						}
-					}
-					else if ( op == "BTJZ" ) // BTJZ %yy,xx,aaaa (jump if any bit of xx masked by %yy is zero)
-					{
-						if ( ass_binop( op, args, 3, 0x07, instr ) )
-						{
-							instr.push_back( getoffset( pc+instr.size()+1, args[2] ) );
-						}
-					}
-					else if ( op == "BTJZP" ) // BTJZP %yy,Pnn,aaaa (jump if any bit of Pnn masked by %yy is zero)
-					{
-						if ( ass_binop_p( op, args, 3, 0x07, instr ) )
-						{
-							instr.push_back( getoffset( pc+instr.size()+1, args[2] ) );
-						}
-					}
-					// ============= PUSH/POP
-					else if ( op == "PUSH" ) // PUSH xx
-					{
-						ass_pushpop( op, args, 0x08, instr );
-					}
-					else if ( op == "POP" ) // POP xx
-					{
-						ass_pushpop( op, args, 0x09, instr );
-					}
-					// ============= SPECIAL
-					else if ( op == "TRAP" ) // POP xx
-					{
-						ass_trap( op, args, instr );
-					}
+						break;
+					// ============= INSTRUCTIONS
+					case OP_MOV:		// MOV ss,dd, MOVD ssss,dddd, MOVP ss,dd
+					case OP_MOVD:
+					case OP_MOVP:
+					case OP_XADDR:		// LDA/STA/BR/CMPA/CALL
+					case OP_IMPLICIT:	// NOP, IDLE, EINT, ...
+					case OP_UNOP:		// DEC xx, ..., DJNZ R,aaaa
+					case OP_BINOP:		// AND yy,xx, ..., BTJO %yy,xx,aaaa
+					case OP_BINOP_P:	// ANDP yy,Pnn, ..., BTJOP %yy,Pnn,aaaa
+					case OP_JUMP:		// JMP aaaa, JZ/JEQ aaaa, ...
+					case OP_PUSHPOP:	// PUSH xx, POP xx
+					case OP_TRAP:		// TRAP n
+						if ( pass == 1 )
+							sized = encodedlength( *opcode, args );
+						else
+							encoder( op, *opcode, args, instr );
+						break;
 					// ============= DATA
-					else if ( op == "BYTE" ) // BYTE x,... (8-bit data)
-					{
+					case OP_BYTE:	// BYTE x,... (8-bit data)
 						if ( !args.size() )
 							log.error( "Missing byte value(s)" );
+						if ( pass == 1 )
+						{
+							sized = args.size();
+							break;
+						}
 						for ( int i=0; i<args.size(); ++i )
 						{
-							instr.push_back( getbyte( args[i] ) );
+							emitbyte( instr, args[i] );
 						}
-					}
-					else if ( op == "DB" ) // DB x,... (8-bit data)
-					{
+						break;
+					case OP_DB:	// DB x,... (8-bit data)
 						if ( !options.nocompatwarning )
 							log.warn( "Non-standard DB statement: %s", argstr.data() );
 						if ( !args.size() )
@@ -1259,22 +1233,21 @@ void main( int argc, const char* argp[] )
 							switch( arg.type )
 							{
 							case ARG_IMM:
-								instr.push_back( getbyte( arg ) );
+								emitbyte( instr, arg );
 								break;
 							case ARG_DUP:
 								listblock = false;
 							case ARG_TEXT:
-								for ( int p=0; p<arg.text.size(); ++p )
-									instr.push_back( arg.text[p] );
+								for ( int p=0; p<arg.gettext().size(); ++p )
+									instr.push_back( arg.gettext()[p] );
 								break;
 							default:
 								log.error( "Bad arg type: %s", ArgTypes::get(arg.type) );
 							}
 
 						}
-					}
-					else if ( op == "DS" ) // DS x,... (8-bit data)
-					{
+						break;
+					case OP_DS:	// DS x,... (8-bit data)
 						if ( !options.nocompatwarning )
 							log.warn( "Non-standard DB statement: %s", argstr.data() );
 						if ( chkargs( op, args, 1 ) )
@@ -1282,65 +1255,63 @@ void main( int argc, const char* argp[] )
 							int skip = args[0].data;
 							pc += skip;
 						}
-					}
-					else if ( op == "TEXT" ) // TEXT "..."
-					{
+						break;
+					case OP_TEXT:	// TEXT "..."
 						if ( chkargs( op, args, 1 ) )
 						{
 							const Arg &arg = args[0];
 							switch( arg.type )
 							{
 							case ARG_TEXT:
-								for ( int p=0; p<arg.text.size(); ++p )
-									instr.push_back( arg.text[p] );
+								for ( int p=0; p<arg.gettext().size(); ++p )
+									instr.push_back( arg.gettext()[p] );
 								break;
 							default:
 								log.error( "Bad arg type: %s", ArgTypes::get(arg.type) );
 							}
 						}
-					}
-					else if ( op == "DATA" || op == "DW" ) // DATA xxxx,... (16-bit data)
-					{
-						if ( !options.nocompatwarning && op == "DW" )
+						break;
+					case OP_DATA:	// DATA xxxx,... (16-bit data)
+						if ( !options.nocompatwarning && opcode->code )
 							log.warn( "Got DW, assuming DATA: %s", argstr.data() );
 						if ( !args.size() )
 							log.error( "Missing byte value(s)" );
+						if ( pass == 1 )
+						{
+							sized = 2 * args.size();
+							break;
+						}
 						for ( int i=0; i<args.size(); ++i )
 						{
-							instr.push_back( gethigh( args[i] ) );
-							instr.push_back( getlow( args[i] ) );
+							emitword( instr, args[i] );
 						}
-					}
-					else if ( op == "EQU" ) // llll EQU xxxx
-					{
+						break;
+					case OP_EQU:	// llll EQU xxxx
 						// no-op
-					}
-					else if ( op == "END" ) // END [aaaa]
-					{
+						break;
+					case OP_END:	// END [aaaa]
 						end = true;
-					}
-					else if ( op == "ERROR" || op == "WARNING" || op == "MESSAGE" || op == "INFO" ) //
-					{
+						break;
+					case OP_MESSAGE:	// ERROR/WARNING/MESSAGE/INFO "..."
 						if ( chkargs( op, args, 1 ) )
 						{
 							const Arg &arg = args[0];
 							switch( arg.type )
 							{
 							case ARG_TEXT:
-								if ( op == "ERROR" )
-									log.error( "%s", arg.text.data() );
-								else if ( op == "WARNING" )
-									log.warn( "%s", arg.text.data() );
+								if ( opcode->code == 0 )
+									log.error( "%s", arg.gettext().data() );
+								else if ( opcode->code == 1 )
+									log.warn( "%s", arg.gettext().data() );
 								else
-									log.info( "%s", arg.text.data() );
+									log.info( "%s", arg.gettext().data() );
 								break;
 							default:
 								log.error( "Bad arg type: %s", ArgTypes::get(arg.type) );
 							}
 						}
-					}
-					else if ( op == "ASSERT_EQUAL" ) //
-					{
+						break;
+					case OP_ASSERT_EQUAL:	// ASSERT_EQUAL x,y
 						if ( chkargs( op, args, 2 ) )
 						{
 							const Arg &arg0 = args[0];
@@ -1349,37 +1320,65 @@ void main( int argc, const char* argp[] )
 							{
 								if ( arg0.text != arg1.text )
 								{
-									log.error( "Assertion failed: %s != %s", arg0.str.data(), arg1.str.data() );
-									log.info( "with %s = '%s'", arg0.str.data(), arg0.text.data() );
-									log.info( " and %s = '%s'", arg1.str.data(), arg1.text.data() );
+									log.error( "Assertion failed: %s != %s", arg0.getstr().data(), arg1.getstr().data() );
+									log.info( "with %s = '%s'", arg0.getstr().data(), arg0.gettext().data() );
+									log.info( " and %s = '%s'", arg1.getstr().data(), arg1.gettext().data() );
 								}
 							}
 							else if ( arg0.type != ARG_TEXT && arg1.type != ARG_TEXT )
 							{
 								if ( arg0.data != arg1.data )
 								{
-									log.error( "Assertion failed: %s != %s", arg0.str.data(), arg1.str.data() );
-									log.info( "with %s = %04X", arg0.str.data(), arg0.data );
-									log.info( " and %s = %04X", arg1.str.data(), arg1.data );
+									log.error( "Assertion failed: %s != %s", arg0.getstr().data(), arg1.getstr().data() );
+									log.info( "with %s = %04X", arg0.getstr().data(), arg0.data );
+									log.info( " and %s = %04X", arg1.getstr().data(), arg1.data );
 								}
 							}
 							else
 							{
-								log.error( "Assertion failed: type of %s incompatible with type of %s", arg0.str.data(), arg1.str.data() );
-								log.info( "with %s as %s", arg0.str.data(), ArgTypes::get(arg0.type) );
-								log.info( " and %s as %s", arg1.str.data(), ArgTypes::get(arg1.type) );
+								log.error( "Assertion failed: type of %s incompatible with type of %s", arg0.getstr().data(), arg1.getstr().data() );
+								log.info( "with %s as %s", arg0.getstr().data(), ArgTypes::get(arg0.type) );
+								log.info( " and %s as %s", arg1.getstr().data(), ArgTypes::get(arg1.type) );
 							}
 						}
-					}
-					else if ( op.empty() )
-					{
+						break;
+					case OP_NONE:
 						outaddr = false;
-					}
-					else					// Unrecognized op-code
-					{
+						break;
+					default:			// Unrecognized op-code
 						log.error( "Unrecognized op-code: [%s]", op.data() );
 					}
 				}
+				}
+			}
+
+			// the addresses of pass 1 hold if the lines keep their length
+			if ( recorded && isline && condit && oldcond
+				&& !log.getErrorsCount() && instr.size() != irline->size )
+			{
+				log.warn( "Phase error: %d bytes in pass 1, %d in pass 2", int( irline->size ), int( instr.size() ) );
+				for ( size_t i=0; i<nargs; ++i )
+				{
+					const IROperand &arg = ir.operand( *irline, i );
+					Arg now = Parser::getarg( argstrs[i], arg.id );
+					if ( now.type != arg.type )
+						log.info( "%s was %s in pass 1, %s in pass 2", argstrs[i].data(),
+							ArgTypes::get(arg.type), ArgTypes::get(now.type) );
+				}
+			}
+
+			if ( fixups.isEnabled() )
+			{
+				// undefined symbols used where no fixup is possible
+				if ( !fixups.hasStaged() )
+				{
+					const vector< string > &undefs = fixups.undefinedNames();
+					for ( size_t i=0; i<undefs.size(); ++i )
+						log.error( "Symbol not found: [%s]", undefs[i].data() );
+				}
+
+				if ( end && names.size() == 1 )
+					unresolvedfixups();
 			}
 
 			if 	( 	( 	options.listall
@@ -1393,7 +1392,11 @@ void main( int argc, const char* argp[] )
 			{
 				if ( isline )
 				{
-					stringstream sstr;
+					stringstream &sstr = listline;
+					sstr.str( string() );
+					sstr.clear();
+					sstr.flags( ios::dec );
+					sstr.fill( ' ' );
 
 					if ( !options.nolinenum )
 						sstr << setw( 5 ) << num << ":  ";
@@ -1421,9 +1424,9 @@ void main( int argc, const char* argp[] )
 						sstr << endl;
 					}
 
-					ostr << sstr.str();
+					ostr << sstr.rdbuf();
 
-					if ( !options.nocerr && !lstfile.empty() && cout != cerr
+					if ( !options.nocerr && &ostr != &cout && cout != cerr
 						&& log.isWarning() )
 					{
 						CDBG << sstr.str();
@@ -1433,14 +1436,27 @@ void main( int argc, const char* argp[] )
 
 				log.writeTo( ostr );
 
-				if ( !options.nocerr && !lstfile.empty() && cout != cerr )
+				if ( !options.nocerr && &ostr != &cout && cout != cerr )
 				{
 					log.writeTo( cerr );
 				}
 
-				if ( out )
+				if ( fixups.isEnabled() )
+				{
+					bool staged = fixups.hasStaged();
+					fixups.commit( image.size() );
+					image.insert( image.end(), instr.begin(), instr.end() );
+
+					// the label of the line, defined after its operands were
+					// staged: LOOP DJNZ R5,LOOP
+					if ( staged && !label.empty() )
+						resolvefixups( label, image );
+				}
+				else if ( out )
+				{
 					for ( int i=0; i<instr.size(); ++i )
-						out.put( instr[i] );
+						out->put( instr[i] );
+				}
 			}
 
 			errcount += log.getErrorsCount();
@@ -1448,14 +1464,37 @@ void main( int argc, const char* argp[] )
 
 			log.clear();
 
-			pc += instr.size();
+			pc += instr.size() + sized;
+			if ( pass == 1 )
+				ir.back().size = instr.size() + sized;
+
+
+			if ( expandline )
+				expanded.add( line, origins.top().name, origin );
 
+			if ( replay )
+			{
+				if ( pushed && !( irline->flags & IRLine::PUSH ) )
+					log.error( "Phase error: include or REPT not taken in pass 1" );
+				else if ( !pushed && ( irline->flags & IRLine::PUSH ) )
+					ir.skipsource();	// included in pass 1 only
+			}
+			else if ( pass == 1 && pushed )
+			{
+				ir.back().flags |= IRLine::PUSH;
+			}
 
-			if ( end && sources.empty() )
+			if ( end && names.size() == 1 )
 				break;
 
 		}
 
+		if ( pass == 1 )
+		{
+			ir.setRecorded();
+			symbols.freeze();
+		}
+
 
 		if ( pass == 2 )
 		{
@@ -1466,15 +1505,51 @@ void main( int argc, const char* argp[] )
 
 			ostr << endl << sstr.str();
 
-			if ( !lstfile.empty() && cout != cerr )
+			if ( &ostr != &cout && cout != cerr )
 			{
 				cerr << sstr.str();
 			}
 		}
 
+		if ( memstats )
+		{
+			cerr << "Pass " << pass << ": " << arena.resets() - linestart << " lines, "
+				<< arena.allocations() - arenastart << " arena allocations ("
+				<< arena.peak() << " bytes peak per line, " << arena.blocks() << " blocks)" << endl;
+		}
+
 	} // pass
 
 
-	out.close();
+	if ( out )
+		for ( size_t i=0; i<image.size(); ++i )
+			out->put( image[i] );
+
+	if ( out )
+		out->flush();
+
+	outf.close();
+
+	if ( expfile == stdio )
+	{
+		cout.flush();
+	}
+	else if ( !expfile.empty() )
+	{
+		expf.close();
+	}
+
+	if ( !expfile.empty() )
+	{
+		ofstream loc( locfile.data(), ios::binary );
+
+		if ( !loc )
+		{
+			cerr << "Failed to open line origin file [" << locfile << "]" << endl;
+			exit( 1 );
+		}
+
+		expanded.writeTable( loc );
+	}
 
 }
@@ -0,0 +1,145 @@
+#pragma once
+
+#include <cstddef>
+#include <new>
+#include <vector>
+
+using namespace std;
+
+/////// ARENA /////////////////////////////////////////////////////////////////
+
+// Bump allocator for the objects living as long as a source line: reset
+// at the start of each line, its blocks are kept and reused, so that the
+// steady state allocates nothing from the heap. Deallocation is a no-op.
+class Arena
+{
+public:
+	explicit Arena( size_t blocksize = 4096 )
+	: blocksize_( blocksize ), current_( 0 ), used_( 0 )
+	, allocations_( 0 ), bytes_( 0 ), peak_( 0 ), resets_( 0 )
+	{
+	}
+
+	~Arena()
+	{
+		for ( size_t i=0; i<blocks_.size(); ++i )
+			::operator delete( blocks_[i].data );
+	}
+
+	void *allocate( size_t size, size_t align )
+	{
+		++allocations_;
+		bytes_ += size;
+
+		for ( ; current_ < blocks_.size(); ++current_, used_ = 0 )
+		{
+			size_t pos = ( used_ + align - 1 ) & ~( align - 1 );
+			if ( pos + size <= blocks_[current_].size )
+			{
+				used_ = pos + size;
+				return blocks_[current_].data + pos;
+			}
+		}
+
+		Block block;
+		block.size = size > blocksize_ ? size : blocksize_;
+		block.data = static_cast< char* >( ::operator new( block.size ) );
+		blocks_.push_back( block );
+		used_ = size;
+		return block.data;
+	}
+
+	// Frees everything allocated since the last reset.
+	void reset()
+	{
+		size_t inuse = used();
+		if ( inuse > peak_ )
+			peak_ = inuse;
+		current_ = 0;
+		used_ = 0;
+		++resets_;
+	}
+
+	// Statistics: allocations and bytes since construction, largest use
+	// between two resets, blocks taken from the heap.
+	size_t allocations() const	{ return allocations_; }
+	size_t bytes() const		{ return bytes_; }
+	size_t peak() const			{ return peak_; }
+	size_t resets() const		{ return resets_; }
+	size_t blocks() const		{ return blocks_.size(); }
+
+private:
+	Arena( const Arena& );
+	Arena &operator=( const Arena& );
+
+	size_t used() const
+	{
+		size_t inuse = used_;
+		for ( size_t i=0; i<current_ && i<blocks_.size(); ++i )
+			inuse += blocks_[i].size;
+		return inuse;
+	}
+
+	struct Block
+	{
+		char	*data;
+		size_t	size;
+	};
+
+	vector< Block > blocks_;
+	size_t blocksize_;
+	size_t current_;	// block being filled
+	size_t used_;		// bytes used in the current block
+	size_t allocations_;
+	size_t bytes_;
+	size_t peak_;
+	size_t resets_;
+};
+
+// Standard allocator on an Arena, for the containers of a line.
+template< class T >
+class ArenaAllocator
+{
+public:
+	typedef T value_type;
+
+	ArenaAllocator( Arena &arena )
+	: arena_( &arena )
+	{
+	}
+
+	template< class U >
+	ArenaAllocator( const ArenaAllocator< U > &other )
+	: arena_( other.arena() )
+	{
+	}
+
+	T *allocate( size_t n )
+	{
+		return static_cast< T* >( arena_->allocate( n * sizeof( T ), alignof( T ) ) );
+	}
+
+	void deallocate( T*, size_t )
+	{
+	}
+
+	Arena *arena() const
+	{
+		return arena_;
+	}
+
+private:
+	Arena *arena_;
+};
+
+template< class T, class U >
+bool operator==( const ArenaAllocator< T > &lhs, const ArenaAllocator< U > &rhs )
+{
+	return lhs.arena() == rhs.arena();
+}
+
+template< class T, class U >
+bool operator!=( const ArenaAllocator< T > &lhs, const ArenaAllocator< U > &rhs )
+{
+	return lhs.arena() != rhs.arena();
+}
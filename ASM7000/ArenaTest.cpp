@@ -0,0 +1,41 @@
+#include "Arena.h"
+
+int main()
+{
+	int ret = 0;
+
+	Arena arena( 64 );
+
+	char *c = static_cast< char* >( arena.allocate( 1, 1 ) );
+	double *d = static_cast< double* >( arena.allocate( sizeof( double ), alignof( double ) ) );
+	ret += ( size_t( d ) % alignof( double ) != 0 );
+	ret += ( (char*)d <= c );
+	ret += ( arena.blocks() != 1 );
+
+	// larger than a block: a block of its own
+	arena.allocate( 100, 1 );
+	ret += ( arena.blocks() != 2 );
+
+	// the blocks are reused after a reset
+	arena.reset();
+	ret += ( arena.allocate( 1, 1 ) != c );
+	arena.allocate( 100, 1 );
+	ret += ( arena.blocks() != 2 );
+	ret += ( arena.allocations() != 5 );
+	ret += ( arena.peak() < 100 );
+
+	arena.reset();
+	vector< int, ArenaAllocator< int > > v( arena );
+	for ( int i=0; i<100; ++i )
+		v.push_back( i );
+	int sum = 0;
+	for ( size_t i=0; i<v.size(); ++i )
+		sum += v[i];
+	ret += ( sum != 4950 );
+
+	ArenaAllocator< char > a( arena );
+	ArenaAllocator< int > b( a );
+	ret += !( a == b );
+
+	return ret;
+}
@@ -1,8 +1,10 @@
 #pragma once
 
 #include "TypeDefs.h"
+#include "StringPool.h"
 
 #include <string>
+#include <type_traits>
 
 using namespace std;
 
@@ -51,12 +53,27 @@ struct ArgTypes
 	}
 };
 
+// Operand or symbol value, copied by value everywhere: its strings are
+// interned in the string pool.
 struct Arg
 {
 	ArgType type;
 	word	data;
-	string	str;
-	string	text;
+	strid_t	str;	// source text
+	strid_t	text;	// payload of TEXT and DUP, 0 otherwise
+	int		undef;	// single-pass: handle of an undefined symbol, or 0
+
+	const string &getstr() const
+	{
+		return stringpool.get( str );
+	}
+
+	const string &gettext() const
+	{
+		return stringpool.get( text );
+	}
 };
 
+static_assert( is_trivially_copyable< Arg >::value, "Arg must stay trivially copyable" );
+
 
@@ -0,0 +1,138 @@
+#pragma once
+
+#include <cstddef>
+#include <cstring>
+
+#if defined( __AVX2__ )
+#include <immintrin.h>
+#define CHARSCAN_AVX2 1
+#define CHARSCAN_SSE2 1
+#elif defined( __SSE2__ ) || defined( _M_X64 ) || ( defined( _M_IX86_FP ) && _M_IX86_FP >= 2 )
+#include <emmintrin.h>
+#define CHARSCAN_SSE2 1
+#endif
+
+#if defined( _MSC_VER ) && CHARSCAN_SSE2
+#include <intrin.h>
+#endif
+
+/////// CHAR SCAN /////////////////////////////////////////////////////////////
+
+// Small set of characters, searched 32 (AVX2) or 16 (SSE2) bytes at a time
+// by comparing each block to every character of the set and taking the
+// first bit of the resulting mask. The scalar loop handles the tail of the
+// string and the builds without SSE2.
+class CharSet
+{
+public:
+	enum { MAXSIMD = 8 };	// larger sets are only searched by the scalar loop
+
+	CharSet()
+	: count_( 0 )
+	{
+		memset( bits_, 0, sizeof bits_ );
+	}
+
+	CharSet( const char *chars, size_t count )
+	: count_( 0 )
+	{
+		memset( bits_, 0, sizeof bits_ );
+		add( chars, count );
+	}
+
+	void add( char c )
+	{
+		if ( contains( c ) )
+			return;
+		bits_[(unsigned char)c >> 5] |= 1u << ( c & 31 );
+		if ( count_ < sizeof chars_ )
+			chars_[count_] = c;
+		++count_;
+	}
+
+	void add( const char *chars, size_t count )
+	{
+		for ( size_t i=0; i<count; ++i )
+			add( chars[i] );
+	}
+
+	bool contains( char c ) const
+	{
+		return ( bits_[(unsigned char)c >> 5] >> ( c & 31 ) ) & 1;
+	}
+
+	// Returns the first character of [p, end) in the set, or end.
+	const char *find( const char *p, const char *end ) const
+	{
+#if CHARSCAN_SSE2
+		if ( count_ <= MAXSIMD )
+			p = findsimd( p, end );
+#endif
+		while ( p < end && !contains( *p ) )
+			++p;
+		return p;
+	}
+
+private:
+#if CHARSCAN_SSE2
+	// Stops at the first block holding a character of the set, or at the
+	// last incomplete block.
+	const char *findsimd( const char *p, const char *end ) const
+	{
+#if CHARSCAN_AVX2
+		if ( end - p >= 32 )
+		{
+			__m256i set[MAXSIMD];
+			for ( size_t i=0; i<count_; ++i )
+				set[i] = _mm256_set1_epi8( chars_[i] );
+			do
+			{
+				__m256i block = _mm256_loadu_si256( (const __m256i*)p );
+				__m256i match = _mm256_setzero_si256();
+				for ( size_t i=0; i<count_; ++i )
+					match = _mm256_or_si256( match, _mm256_cmpeq_epi8( block, set[i] ) );
+				unsigned mask = unsigned( _mm256_movemask_epi8( match ) );
+				if ( mask )
+					return p + firstbit( mask );
+				p += 32;
+			}
+			while ( end - p >= 32 );
+		}
+#endif
+		if ( end - p >= 16 )
+		{
+			__m128i set[MAXSIMD];
+			for ( size_t i=0; i<count_; ++i )
+				set[i] = _mm_set1_epi8( chars_[i] );
+			do
+			{
+				__m128i block = _mm_loadu_si128( (const __m128i*)p );
+				__m128i match = _mm_setzero_si128();
+				for ( size_t i=0; i<count_; ++i )
+					match = _mm_or_si128( match, _mm_cmpeq_epi8( block, set[i] ) );
+				unsigned mask = unsigned( _mm_movemask_epi8( match ) );
+				if ( mask )
+					return p + firstbit( mask );
+				p += 16;
+			}
+			while ( end - p >= 16 );
+		}
+		return p;
+	}
+
+	static unsigned firstbit( unsigned mask )
+	{
+#ifdef _MSC_VER
+		unsigned long index;
+		_BitScanForward( &index, mask );
+		return index;
+#else
+		return __builtin_ctz( mask );
+#endif
+	}
+#endif
+
+	unsigned bits_[8];
+	char chars_[MAXSIMD];
+	size_t count_;
+};
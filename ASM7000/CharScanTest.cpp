@@ -0,0 +1,28 @@
+#include "CharScan.h"
+
+#include <string>
+
+using namespace std;
+
+int main()
+{
+	CharSet set( "\t :", 3 );
+	set.add( '\0' );
+
+	int ret = set.contains( 'A' ) + !set.contains( ':' ) + !set.contains( '\0' );
+
+	// the match in each position of the SIMD blocks and of the tail
+	for ( size_t len=1; len<80; ++len )
+	{
+		for ( size_t pos=0; pos<=len; ++pos )
+		{
+			string str( len, 'x' );
+			if ( pos < len )
+				str[pos] = ':';
+			const char *found = set.find( str.data(), str.data() + len );
+			ret += ( found != str.data() + pos );
+		}
+	}
+
+	return ret;
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include "StringView.h"
+#include "TypeDefs.h"
+
+#include <cstddef>
+
+/////// CPU ///////////////////////////////////////////////////////////////////
+
+// Members of the TMS7000 family, selected by the CPU directive or option
+// -CPU:name. They share the instruction set; they differ by the size of the
+// register file (on-chip RAM) and by the on-chip ports of the peripheral
+// file. Each variant is a traits class the encoder is instantiated with, so
+// that the generic variant has no check at all.
+
+enum CpuVariant
+{
+	CPU_GENERIC = 0,	// no check
+	CPU_7000,			// 128 registers, P0-P11
+	CPU_7001,			// 128 registers, P0-P23 (serial port, timer 2)
+	CPU_7042,			// 256 registers, P0-P23
+	CPU_70C42,			// 256 registers, P0-P11
+	CPU_VARIANTS
+};
+
+template< size_t REGS, size_t PORTS >
+struct CpuTraits
+{
+	enum
+	{
+		REGISTERS = REGS,		// R0 - R(REGISTERS-1)
+		ONCHIP_PORTS = PORTS	// P0 - P(ONCHIP_PORTS-1), others off-chip
+	};
+
+	static const bool CHECKED = REGS < 256 || PORTS < 256;
+
+	static bool isregister( word n )
+	{
+		return n < REGISTERS;
+	}
+
+	static bool isonchip( word port )
+	{
+		return port < ONCHIP_PORTS;
+	}
+};
+
+typedef CpuTraits< 256, 256 >	CpuGeneric;
+typedef CpuTraits< 128, 12 >	Cpu7000;
+typedef CpuTraits< 128, 24 >	Cpu7001;
+typedef CpuTraits< 256, 24 >	Cpu7042;
+typedef CpuTraits< 256, 12 >	Cpu70C42;
+
+struct CpuModel
+{
+	const char	*name;
+	CpuVariant	variant;
+};
+
+constexpr CpuModel cpumodels[] =
+{
+	{ "TMS7000",	CPU_7000 },
+	{ "TMS7020",	CPU_7000 },
+	{ "TMS7040",	CPU_7000 },
+	{ "TMS70C00",	CPU_7000 },
+	{ "TMS70C20",	CPU_7000 },
+	{ "TMS70C40",	CPU_7000 },
+	{ "TMS7001",	CPU_7001 },
+	{ "TMS7041",	CPU_7001 },
+	{ "TMS7042",	CPU_7042 },
+	{ "TMS70C02",	CPU_70C42 },
+	{ "TMS70C42",	CPU_70C42 },
+	{ "GENERIC",	CPU_GENERIC },
+};
+
+class Cpus
+{
+public:
+	// Returns the model of a part name, 0 if unknown. "PIC7000" and "7000"
+	// stand for "TMS7000".
+	static const CpuModel *find( const StringView &name )
+	{
+		StringView part = name;
+		if ( startswith( part, "PIC" ) || startswith( part, "TMS" ) )
+			part = part.substr( 3 );
+		for ( size_t i=0; i<sizeof cpumodels / sizeof cpumodels[0]; ++i )
+		{
+			StringView model = cpumodels[i].name;
+			if ( startswith( model, "TMS" ) )
+				model = model.substr( 3 );
+			if ( part == model )
+				return &cpumodels[i];
+		}
+		return 0;
+	}
+
+private:
+	static bool startswith( const StringView &str, const char *prefix )
+	{
+		size_t i = 0;
+		for ( ; prefix[i]; ++i )
+		{
+			if ( i >= str.size() || str[i] != prefix[i] )
+				return false;
+		}
+		return true;
+	}
+};
@@ -0,0 +1,28 @@
+#include "Cpu.h"
+
+int main()
+{
+	int ret = 0;
+
+	const CpuModel *cpu = Cpus::find( "TMS7040" );
+	ret += !cpu || cpu->variant != CPU_7000;
+	cpu = Cpus::find( "7041" );
+	ret += !cpu || cpu->variant != CPU_7001;
+	cpu = Cpus::find( "PIC7000" );
+	ret += !cpu || cpu->variant != CPU_7000;
+	cpu = Cpus::find( "TMS70C42" );
+	ret += !cpu || cpu->variant != CPU_70C42;
+	cpu = Cpus::find( "GENERIC" );
+	ret += !cpu || cpu->variant != CPU_GENERIC;
+	ret += ( Cpus::find( "TMS" ) != 0 );
+	ret += ( Cpus::find( "Z80" ) != 0 );
+
+	ret += CpuGeneric::CHECKED;
+	ret += !Cpu7000::CHECKED;
+	ret += !Cpu7000::isregister( 127 ) || Cpu7000::isregister( 128 );
+	ret += !Cpu7042::isregister( 255 );
+	ret += !Cpu7000::isonchip( 11 ) || Cpu7000::isonchip( 12 );
+	ret += !Cpu7001::isonchip( 23 ) || Cpu7001::isonchip( 24 );
+
+	return ret;
+}
@@ -0,0 +1,249 @@
+#pragma once
+
+#include "ArgType.h"
+#include "Opcodes.h"
+
+/////// ENCODINGS /////////////////////////////////////////////////////////////
+
+// Instruction encodings, by encoder group (the handler of the mnemonic) and
+// types of the operands that select the form: opcode byte and operands
+// emitted after it. The opcode of the mnemonic (Opcode::code) is or'ed to
+// the opcode of the form. Mnemonics with a jump target (DJNZ, BTJx) emit its
+// offset after the encoded operands.
+
+enum EmitKind
+{
+	EMIT_NONE = 0,
+	EMIT_NUM,		// register or port number, 1 byte
+	EMIT_BYTE,		// 8-bit value, 1 byte
+	EMIT_WORD,		// 16-bit address or value, 2 bytes
+	EMIT_REL		// offset from the address after it, 1 byte
+};
+
+enum OpcodeForm
+{
+	FORM_OR = 0,	// form opcode | mnemonic code
+	FORM_ABS,		// form opcode as is
+	FORM_TRAP		// form opcode - value of the operand
+};
+
+enum
+{
+	ENC_COMPAT	= 1,	// extension: compatibility warning
+	ENC_DEFAULT	= 2		// any other operand types: error, then encoded
+};
+
+struct Emit
+{
+	EmitKind	kind;
+	int			arg;	// operand index
+};
+
+struct Encoding
+{
+	OpHandler	group;
+	ArgType		type0;	// ARG_NONE: no operand
+	ArgType		type1;
+	int			match;	// form of this mnemonic code only, or -1
+	int			opcode;
+	OpcodeForm	form;
+	int			flags;
+	Emit		emit[2];
+};
+
+#define E_NONE		{ EMIT_NONE, 0 }
+#define E_NUM( n )	{ EMIT_NUM, n }
+#define E_BYTE( n )	{ EMIT_BYTE, n }
+#define E_WORD( n )	{ EMIT_WORD, n }
+#define E_REL( n )	{ EMIT_REL, n }
+
+constexpr Encoding encodings[] =
+{
+	// MOV
+	{ OP_MOV,		ARG_REG,	ARG_A,		-1,		0x12,	FORM_OR,	0,				{ E_NUM( 0 ),	E_NONE } },
+	{ OP_MOV,		ARG_IMM,	ARG_A,		-1,		0x22,	FORM_OR,	0,				{ E_BYTE( 0 ),	E_NONE } },
+	{ OP_MOV,		ARG_REG,	ARG_B,		-1,		0x32,	FORM_OR,	0,				{ E_NUM( 0 ),	E_NONE } },
+	{ OP_MOV,		ARG_REG,	ARG_REG,	-1,		0x42,	FORM_OR,	0,				{ E_NUM( 0 ),	E_NUM( 1 ) } },
+	{ OP_MOV,		ARG_IMM,	ARG_B,		-1,		0x52,	FORM_OR,	0,				{ E_BYTE( 0 ),	E_NONE } },
+	{ OP_MOV,		ARG_B,		ARG_A,		-1,		0x62,	FORM_OR,	0,				{ E_NONE,		E_NONE } },
+	{ OP_MOV,		ARG_IMM,	ARG_REG,	-1,		0x72,	FORM_OR,	0,				{ E_BYTE( 0 ),	E_NUM( 1 ) } },
+	{ OP_MOV,		ARG_A,		ARG_B,		-1,		0xC0,	FORM_OR,	0,				{ E_NONE,		E_NONE } },
+	{ OP_MOV,		ARG_A,		ARG_REG,	-1,		0xD0,	FORM_OR,	0,				{ E_NUM( 1 ),	E_NONE } },
+	{ OP_MOV,		ARG_B,		ARG_REG,	-1,		0xD1,	FORM_OR,	0,				{ E_NUM( 1 ),	E_NONE } },
+	// MOVD
+	{ OP_MOVD,		ARG_IMM,	ARG_REG,	-1,		0x88,	FORM_OR,	0,				{ E_WORD( 0 ),	E_NUM( 1 ) } },
+	{ OP_MOVD,		ARG_REG,	ARG_REG,	-1,		0x98,	FORM_OR,	0,				{ E_NUM( 0 ),	E_NUM( 1 ) } },
+	{ OP_MOVD,		ARG_EFFEC,	ARG_REG,	-1,		0xA8,	FORM_OR,	0,				{ E_WORD( 0 ),	E_NUM( 1 ) } },
+	// MOVP
+	{ OP_MOVP,		ARG_A,		ARG_PORT,	-1,		0x82,	FORM_OR,	0,				{ E_NUM( 1 ),	E_NONE } },
+	{ OP_MOVP,		ARG_B,		ARG_PORT,	-1,		0x92,	FORM_OR,	0,				{ E_NUM( 1 ),	E_NONE } },
+	{ OP_MOVP,		ARG_IMM,	ARG_PORT,	-1,		0xA2,	FORM_OR,	0,				{ E_BYTE( 0 ),	E_NUM( 1 ) } },
+	{ OP_MOVP,		ARG_PORT,	ARG_A,		-1,		0x80,	FORM_OR,	0,				{ E_NUM( 0 ),	E_NONE } },
+	{ OP_MOVP,		ARG_PORT,	ARG_B,		-1,		0x91,	FORM_OR,	0,				{ E_NUM( 0 ),	E_NONE } },
+	// LDA, STA, BR, CMPA, CALL
+	{ OP_XADDR,		ARG_DIR,	ARG_NONE,	-1,		0x80,	FORM_OR,	0,				{ E_WORD( 0 ),	E_NONE } },
+	{ OP_XADDR,		ARG_INDIR,	ARG_NONE,	-1,		0x90,	FORM_OR,	0,				{ E_NUM( 0 ),	E_NONE } },
+	{ OP_XADDR,		ARG_INDEX,	ARG_NONE,	-1,		0xA0,	FORM_OR,	0,				{ E_WORD( 0 ),	E_NONE } },
+	{ OP_XADDR,		ARG_IMM,	ARG_NONE,	-1,		0x80,	FORM_OR,	ENC_COMPAT,		{ E_WORD( 0 ),	E_NONE } },
+	{ OP_XADDR,		ARG_REG,	ARG_NONE,	-1,		0x80,	FORM_OR,	ENC_COMPAT,		{ E_WORD( 0 ),	E_NONE } },
+	{ OP_XADDR,		ARG_NONE,	ARG_NONE,	-1,		0x80,	FORM_OR,	ENC_DEFAULT,	{ E_WORD( 0 ),	E_NONE } },
+	// NOP, IDLE, ...
+	{ OP_IMPLICIT,	ARG_NONE,	ARG_NONE,	-1,		0x00,	FORM_OR,	0,				{ E_NONE,		E_NONE } },
+	// DEC, INC, ..., DJNZ
+	{ OP_UNOP,		ARG_A,		ARG_NONE,	-1,		0xB0,	FORM_OR,	0,				{ E_NONE,		E_NONE } },
+	{ OP_UNOP,		ARG_B,		ARG_NONE,	-1,		0xC0,	FORM_OR,	0,				{ E_NONE,		E_NONE } },
+	{ OP_UNOP,		ARG_REG,	ARG_NONE,	-1,		0xD0,	FORM_OR,	0,				{ E_NUM( 0 ),	E_NONE } },
+	// AND, OR, ..., BTJO, BTJZ
+	{ OP_BINOP,		ARG_REG,	ARG_A,		-1,		0x10,	FORM_OR,	0,				{ E_NUM( 0 ),	E_NONE } },
+	{ OP_BINOP,		ARG_IMM,	ARG_A,		-1,		0x20,	FORM_OR,	0,				{ E_NUM( 0 ),	E_NONE } },
+	{ OP_BINOP,		ARG_REG,	ARG_B,		-1,		0x30,	FORM_OR,	0,				{ E_NUM( 0 ),	E_NONE } },
+	{ OP_BINOP,		ARG_REG,	ARG_REG,	-1,		0x40,	FORM_OR,	0,				{ E_NUM( 0 ),	E_NUM( 1 ) } },
+	{ OP_BINOP,		ARG_IMM,	ARG_B,		-1,		0x50,	FORM_OR,	0,				{ E_NUM( 0 ),	E_NONE } },
+	{ OP_BINOP,		ARG_B,		ARG_A,		-1,		0x60,	FORM_OR,	0,				{ E_NONE,		E_NONE } },
+	{ OP_BINOP,		ARG_IMM,	ARG_REG,	-1,		0x70,	FORM_OR,	0,				{ E_NUM( 0 ),	E_NUM( 1 ) } },
+	// ANDP, ORP, XORP, BTJOP, BTJZP
+	{ OP_BINOP_P,	ARG_A,		ARG_PORT,	-1,		0x80,	FORM_OR,	0,				{ E_NUM( 1 ),	E_NONE } },
+	{ OP_BINOP_P,	ARG_B,		ARG_PORT,	-1,		0x90,	FORM_OR,	0,				{ E_NUM( 1 ),	E_NONE } },
+	{ OP_BINOP_P,	ARG_IMM,	ARG_PORT,	-1,		0xA0,	FORM_OR,	0,				{ E_BYTE( 0 ),	E_NUM( 1 ) } },
+	// JMP, JN, ...
+	{ OP_JUMP,		ARG_IMM,	ARG_NONE,	-1,		0xE0,	FORM_OR,	0,				{ E_REL( 0 ),	E_NONE } },
+	// PUSH, POP
+	{ OP_PUSHPOP,	ARG_A,		ARG_NONE,	-1,		0xB0,	FORM_OR,	0,				{ E_NONE,		E_NONE } },
+	{ OP_PUSHPOP,	ARG_B,		ARG_NONE,	-1,		0xC0,	FORM_OR,	0,				{ E_NONE,		E_NONE } },
+	{ OP_PUSHPOP,	ARG_REG,	ARG_NONE,	-1,		0xD0,	FORM_OR,	0,				{ E_NUM( 0 ),	E_NONE } },
+	{ OP_PUSHPOP,	ARG_ST,		ARG_NONE,	0x08,	0x0E,	FORM_ABS,	0,				{ E_NONE,		E_NONE } },
+	{ OP_PUSHPOP,	ARG_ST,		ARG_NONE,	0x09,	0x08,	FORM_ABS,	0,				{ E_NONE,		E_NONE } },
+	// TRAP n
+	{ OP_TRAP,		ARG_IMM,	ARG_NONE,	-1,		0xFF,	FORM_TRAP,	0,				{ E_NONE,		E_NONE } },
+};
+
+#undef E_NONE
+#undef E_NUM
+#undef E_BYTE
+#undef E_WORD
+#undef E_REL
+
+const size_t ENCODING_COUNT = sizeof encodings / sizeof encodings[0];
+const size_t ENCODING_GROUPS = OP_TRAP - OP_MOV + 1;
+const size_t ENCODING_TYPES = 16;
+
+// Index + 1 of the first encoding of each (group, type0, type1), 0 if none.
+struct EncodingIndex
+{
+	unsigned char index[ENCODING_GROUPS][ENCODING_TYPES][ENCODING_TYPES];
+};
+
+constexpr bool encodingsamekey( const Encoding &lhs, const Encoding &rhs )
+{
+	return lhs.group == rhs.group && lhs.type0 == rhs.type0 && lhs.type1 == rhs.type1;
+}
+
+constexpr EncodingIndex encodingindex()
+{
+	EncodingIndex ret = {};
+
+	// defaults of the group first, overwritten by the exact forms
+	for ( size_t i=0; i<ENCODING_COUNT; ++i )
+	{
+		const Encoding &enc = encodings[i];
+		if ( enc.flags & ENC_DEFAULT )
+		{
+			for ( size_t t0=0; t0<ENCODING_TYPES; ++t0 )
+				for ( size_t t1=0; t1<ENCODING_TYPES; ++t1 )
+					ret.index[enc.group - OP_MOV][t0][t1] = (unsigned char)( i + 1 );
+		}
+	}
+
+	for ( size_t i=0; i<ENCODING_COUNT; ++i )
+	{
+		const Encoding &enc = encodings[i];
+		unsigned char &cell = ret.index[enc.group - OP_MOV][enc.type0][enc.type1];
+		if ( !( enc.flags & ENC_DEFAULT ) && ( !cell || !encodingsamekey( encodings[cell - 1], enc )
+			|| ( encodings[cell - 1].flags & ENC_DEFAULT ) ) )
+			cell = (unsigned char)( i + 1 );
+	}
+	return ret;
+}
+
+// The forms of a key are contiguous and unique for each mnemonic code.
+constexpr bool encodingsvalid()
+{
+	for ( size_t i=0; i<ENCODING_COUNT; ++i )
+	{
+		const Encoding &enc = encodings[i];
+		if ( enc.group < OP_MOV || enc.group > OP_TRAP
+			|| enc.type0 >= ENCODING_TYPES || enc.type1 >= ENCODING_TYPES )
+			return false;
+		for ( size_t j=i+1; j<ENCODING_COUNT; ++j )
+		{
+			if ( encodingsamekey( enc, encodings[j] ) )
+			{
+				if ( enc.match == -1 || encodings[j].match == -1 || enc.match == encodings[j].match )
+					return false;
+				if ( j != i + 1 && !encodingsamekey( enc, encodings[j - 1] ) )
+					return false;
+			}
+		}
+	}
+	return true;
+}
+
+static_assert( ENCODING_COUNT < 256, "encoding index doesn't fit in the table" );
+static_assert( encodingsvalid(), "bad encoding table" );
+
+constexpr EncodingIndex encodingtable = encodingindex();
+
+class Encodings
+{
+public:
+	// Returns the encoding of the operand types for a mnemonic, 0 if none.
+	static const Encoding *find( const Opcode &opcode, ArgType type0, ArgType type1 )
+	{
+		if ( opcode.handler < OP_MOV || opcode.handler > OP_TRAP
+			|| size_t( type0 ) >= ENCODING_TYPES || size_t( type1 ) >= ENCODING_TYPES )
+			return 0;
+		unsigned char index = encodingtable.index[opcode.handler - OP_MOV][type0][type1];
+		if ( !index )
+			return 0;
+		const Encoding *enc = &encodings[index - 1];
+		for ( const Encoding *it = enc; it < encodings + ENCODING_COUNT && encodingsamekey( *it, *enc ); ++it )
+		{
+			if ( it->match == -1 || it->match == opcode.code )
+				return it;
+		}
+		return 0;
+	}
+
+	// Number of operands selecting the form.
+	static size_t keyargs( const Opcode &opcode )
+	{
+		return opcode.nargs - ( opcode.jump ? 1 : 0 );
+	}
+
+	// Length of the instruction: opcode, operands and jump offset.
+	static size_t length( const Opcode &opcode, const Encoding &enc )
+	{
+		size_t len = 1;
+		for ( size_t i=0; i<2; ++i )
+		{
+			if ( enc.emit[i].kind == EMIT_WORD )
+				len += 2;
+			else if ( enc.emit[i].kind != EMIT_NONE )
+				len += 1;
+		}
+		return len + ( opcode.jump ? 1 : 0 );
+	}
+
+	static byte opcodebyte( const Opcode &opcode, const Encoding &enc, word arg0 )
+	{
+		switch ( enc.form )
+		{
+		case FORM_ABS:
+			return byte( enc.opcode );
+		case FORM_TRAP:
+			return byte( enc.opcode - arg0 );
+		default:
+			return byte( enc.opcode | opcode.code );
+		}
+	}
+};
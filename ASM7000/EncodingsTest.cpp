@@ -0,0 +1,52 @@
+#include "Encodings.h"
+
+int main()
+{
+	int ret = 0;
+
+	const Opcode &mov = *Opcodes::find( "MOV" );
+	const Encoding *enc = Encodings::find( mov, ARG_IMM, ARG_REG );
+	ret += !enc || Encodings::opcodebyte( mov, *enc, 0 ) != 0x72 || Encodings::length( mov, *enc ) != 3;
+	ret += ( Encodings::find( mov, ARG_A, ARG_PORT ) != 0 );
+
+	const Opcode &btjo = *Opcodes::find( "BTJO" );
+	enc = Encodings::find( btjo, ARG_IMM, ARG_A );
+	ret += !enc || Encodings::opcodebyte( btjo, *enc, 0 ) != 0x26 || Encodings::length( btjo, *enc ) != 3;
+	ret += ( Encodings::keyargs( btjo ) != 2 );
+
+	const Opcode &djnz = *Opcodes::find( "DJNZ" );
+	enc = Encodings::find( djnz, ARG_REG, ARG_NONE );
+	ret += !enc || Encodings::opcodebyte( djnz, *enc, 0 ) != 0xDA || Encodings::length( djnz, *enc ) != 3;
+
+	// any other operand of the memory access is an error, encoded as direct
+	const Opcode &lda = *Opcodes::find( "LDA" );
+	enc = Encodings::find( lda, ARG_A, ARG_NONE );
+	ret += !enc || !( enc->flags & ENC_DEFAULT ) || Encodings::opcodebyte( lda, *enc, 0 ) != 0x8A;
+	enc = Encodings::find( lda, ARG_INDIR, ARG_NONE );
+	ret += !enc || enc->flags || Encodings::opcodebyte( lda, *enc, 0 ) != 0x9A;
+	enc = Encodings::find( lda, ARG_REG, ARG_NONE );
+	ret += !enc || !( enc->flags & ENC_COMPAT ) || Encodings::length( lda, *enc ) != 3;
+
+	// the forms of PUSH ST and POP ST differ
+	const Opcode &push = *Opcodes::find( "PUSH" );
+	const Opcode &pop = *Opcodes::find( "POP" );
+	enc = Encodings::find( push, ARG_ST, ARG_NONE );
+	ret += !enc || Encodings::opcodebyte( push, *enc, 0 ) != 0x0E;
+	enc = Encodings::find( pop, ARG_ST, ARG_NONE );
+	ret += !enc || Encodings::opcodebyte( pop, *enc, 0 ) != 0x08;
+	enc = Encodings::find( pop, ARG_REG, ARG_NONE );
+	ret += !enc || Encodings::opcodebyte( pop, *enc, 0 ) != 0xD9;
+
+	const Opcode &trap = *Opcodes::find( "TRAP" );
+	enc = Encodings::find( trap, ARG_IMM, ARG_NONE );
+	ret += !enc || Encodings::opcodebyte( trap, *enc, 3 ) != 0xFC || Encodings::length( trap, *enc ) != 1;
+
+	const Opcode &nop = *Opcodes::find( "NOP" );
+	enc = Encodings::find( nop, ARG_NONE, ARG_NONE );
+	ret += !enc || Encodings::opcodebyte( nop, *enc, 0 ) != 0x00;
+
+	// directives have no encoding
+	ret += ( Encodings::find( *Opcodes::find( "EQU" ), ARG_IMM, ARG_NONE ) != 0 );
+
+	return ret;
+}
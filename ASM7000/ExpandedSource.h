@@ -0,0 +1,95 @@
+#pragma once
+
+#include "StringView.h"
+
+#include <string>
+#include <vector>
+#include <ostream>
+
+using namespace std;
+
+/////// EXPANDED SOURCE ///////////////////////////////////////////////////////
+
+// Origin of the lines read from a source: a file, or a REPT block whose
+// body repeats the lines of the file from line first.
+struct LineOrigin
+{
+	string	name;
+	size_t	first;	// REPT: file line of the first line of the body
+	size_t	size;	// REPT: lines in the body, 0 for a file
+	size_t	count;	// REPT: lines read so far
+
+	// File line of the next line read, num its number in the source.
+	size_t next( size_t num )
+	{
+		if ( !size )
+			return num;
+		return first + count++ % size;
+	}
+};
+
+// Preprocessed source (option -E): the lines actually assembled, with the
+// includes inlined, the conditionals resolved and the REPT blocks expanded.
+// The origin of the lines is kept as runs of consecutive lines of the same
+// source, written as a separate table:
+//		output-line	count	source-line	source
+class ExpandedSource
+{
+public:
+	ExpandedSource()
+	: out_( 0 ), lines_( 0 )
+	{
+	}
+
+	void setOutput( ostream *out )
+	{
+		out_ = out;
+	}
+
+	bool isEnabled() const
+	{
+		return out_ != 0;
+	}
+
+	void add( const StringView &line, const string &name, size_t num )
+	{
+		out_->write( line.data(), line.size() );
+		*out_ << '\n';
+		++lines_;
+
+		if ( runs_.empty() || runs_.back().name != name
+			|| runs_.back().num + runs_.back().count != num )
+		{
+			Run run = { lines_, 0, num, name };
+			runs_.push_back( run );
+		}
+		++runs_.back().count;
+	}
+
+	size_t lines() const
+	{
+		return lines_;
+	}
+
+	void writeTable( ostream &out ) const
+	{
+		for ( size_t i=0; i<runs_.size(); ++i )
+		{
+			const Run &run = runs_[i];
+			out << run.line << '\t' << run.count << '\t' << run.num << '\t' << run.name << '\n';
+		}
+	}
+
+private:
+	struct Run
+	{
+		size_t	line;	// first output line, 1-based
+		size_t	count;
+		size_t	num;	// first source line, 1-based
+		string	name;
+	};
+
+	ostream *out_;
+	size_t lines_;
+	vector< Run > runs_;
+};
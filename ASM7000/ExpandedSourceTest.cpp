@@ -0,0 +1,24 @@
+#include "ExpandedSource.h"
+
+#include <sstream>
+
+int main()
+{
+	ostringstream out, table;
+	ExpandedSource expanded;
+
+	if ( expanded.isEnabled() )
+		return 1;
+
+	expanded.setOutput( &out );
+	expanded.add( "\tORG\t>F000", "MAIN.ASM", 1 );
+	expanded.add( "A\tEQU\t1", "A.EQU", 1 );
+	expanded.add( "B\tEQU\t2", "A.EQU", 2 );
+	expanded.add( "\tDB\tA,B", "MAIN.ASM", 3 );
+	expanded.add( "\tEND", "MAIN.ASM", 4 );
+	expanded.writeTable( table );
+
+	return	( out.str() != "\tORG\t>F000\nA\tEQU\t1\nB\tEQU\t2\n\tDB\tA,B\n\tEND\n" )
+		+	( table.str() != "1\t1\t1\tMAIN.ASM\n2\t2\t1\tA.EQU\n4\t2\t3\tMAIN.ASM\n" )
+		+	( expanded.lines() != 5 );
+}
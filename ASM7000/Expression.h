@@ -0,0 +1,337 @@
+#pragma once
+
+#include "Symbols.h"
+
+#include <deque>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+extern word pc;
+
+/////// EXPRESSIONS ///////////////////////////////////////////////////////////
+
+// Operand expressions compiled to postfix code by Parser::compile, in the
+// grammar of the parser: values combined left to right, parentheses. The
+// code keeps the names as handles, looked up when it runs, so it stays valid
+// while the symbols change, from pass to pass.
+
+enum ExprOp
+{
+	EXPR_VALUE = 0,	// push arg: number or text
+	EXPR_PC,		// push $
+	EXPR_NAME,		// push the symbol name, else the register or port in arg
+	EXPR_PARAM,		// function body: push the argument arg.data
+	EXPR_ARGS,		// call of the function name with arg.data arguments
+	EXPR_ARG,		// the value pushed is the next argument
+	EXPR_CALL,		// pop the arguments, push the result
+	EXPR_ADD,
+	EXPR_SUB,
+	EXPR_MUL,
+	EXPR_DIV,
+	EXPR_MOD,
+	EXPR_AND,
+	EXPR_OR,
+	EXPR_XOR,
+	EXPR_SHL,
+	EXPR_SHR
+};
+
+struct ExprCode
+{
+	ExprOp	op;
+	strid_t	name;	// EXPR_NAME, EXPR_ARGS
+	Arg		arg;	// EXPR_NAME: ARG_UNDEF if not a register or port name
+};
+
+struct FunctionCode;
+
+// Arguments of a function call, on the stack of the caller. They are visible
+// by name to the expressions evaluated during the call, innermost call first,
+// as the parameters defined as local symbols by the parser are.
+struct ExprFrame
+{
+	const FunctionCode	*func;
+	const Arg			*args;
+	size_t				bound;	// arguments evaluated so far
+	const ExprFrame		*parent;
+};
+
+class Expression
+{
+public:
+	enum
+	{
+		STACK = 16,	// deepest nesting compiled
+		CALLS = 64	// deepest nesting of function calls evaluated
+	};
+
+	Expression()
+	: stack_( 0 ), text_( 0 )
+	{
+	}
+
+	bool compiled() const
+	{
+		return !code_.empty();
+	}
+
+	// Runs the code, false if the parser has to evaluate the expression:
+	// not compiled, undefined symbol or function, error to report.
+	bool evaluate( Arg &ret ) const
+	{
+		return run( 0, 0, ret );
+	}
+
+	vector< ExprCode > code_;
+	size_t stack_;	// depth of the stack
+	strid_t text_;	// source text, of the values without one
+
+private:
+	bool run( const ExprFrame *outer, size_t calls, Arg &ret ) const;
+
+	static bool lookup( const ExprCode &code, const ExprFrame *frame, Arg &ret );
+
+	static bool apply( ExprOp op, word &lhs, word rhs )
+	{
+		switch ( op )
+		{
+		case EXPR_ADD:	lhs += rhs;		break;
+		case EXPR_SUB:	lhs -= rhs;		break;
+		case EXPR_MUL:	lhs *= rhs;		break;
+		case EXPR_AND:	lhs &= rhs;		break;
+		case EXPR_OR:	lhs |= rhs;		break;
+		case EXPR_XOR:	lhs ^= rhs;		break;
+		case EXPR_SHL:	lhs <<= rhs;	break;
+		case EXPR_SHR:	lhs >>= rhs;	break;
+		case EXPR_DIV:
+			if ( !rhs )
+				return false;
+			lhs /= rhs;
+			break;
+		case EXPR_MOD:
+			if ( !rhs )
+				return false;
+			lhs %= rhs;
+			break;
+		default:
+			return false;
+		}
+		return true;
+	}
+};
+
+// User function compiled when defined, its parameters as argument slots.
+struct FunctionCode
+{
+	vector< strid_t > params_;
+	Expression body_;	// not compiled: the parser evaluates the calls
+};
+
+// Compiled expressions by interned text, for the run: an operand repeated
+// in the source, or assembled again in pass 2, is parsed once. Compiled
+// functions by name, for the pass.
+class Expressions
+{
+public:
+	const Expression *find( strid_t id ) const
+	{
+		const Expression *const *expr = index_.find( id );
+		return expr ? *expr : 0;
+	}
+
+	const Expression *add( strid_t id, const Expression &expr )
+	{
+		expressions_.push_back( expr );
+		index_.set( id, &expressions_.back() );	// the deque doesn't move its elements
+		return &expressions_.back();
+	}
+
+	size_t size() const
+	{
+		return expressions_.size();
+	}
+
+	// body: compiled with the parameters as names, turned into slots here.
+	void define( const string &name, const vector< string > &params, const Expression &body )
+	{
+		FunctionCode func;
+		func.body_ = body;
+		for ( size_t i=0; i<params.size(); ++i )
+		{
+			func.params_.push_back( stringpool.intern( params[i] ) );
+			if ( Registers::isname( params[i] ) )
+				func.body_.code_.clear();	// shadows a register: left to the parser
+		}
+
+		vector< ExprCode > &code = func.body_.code_;
+		for ( size_t i=0; i<code.size(); ++i )
+		{
+			for ( size_t j = params.size(); j-- > 0; )	// the last one of a name
+			{
+				if ( code[i].name != func.params_[j] )
+					continue;
+				if ( code[i].op == EXPR_NAME )
+				{
+					code[i].op = EXPR_PARAM;
+					code[i].arg.data = word( j );
+					break;
+				}
+				if ( code[i].op == EXPR_ARGS )
+				{
+					code.clear();	// a parameter called: error reported by the parser
+					break;
+				}
+			}
+		}
+
+		functions_.push_back( func );
+		functionindex_.set( stringpool.intern( name ), &functions_.back() );
+	}
+
+	const FunctionCode *function( strid_t name ) const
+	{
+		const FunctionCode *const *func = functionindex_.find( name );
+		return func ? *func : 0;
+	}
+
+	// The functions are defined again by each pass.
+	void clearFunctions()
+	{
+		functions_.clear();
+		functionindex_ = IdTable< const FunctionCode* >();
+	}
+
+private:
+	deque< Expression > expressions_;
+	IdTable< const Expression* > index_;
+	deque< FunctionCode > functions_;
+	IdTable< const FunctionCode* > functionindex_;
+};
+
+extern Expressions expressions;
+
+inline bool Expression::lookup( const ExprCode &code, const ExprFrame *frame, Arg &ret )
+{
+	if ( code.arg.type != ARG_UNDEF && !symbols.definesRegisters() )
+	{
+		ret = code.arg;
+		return true;
+	}
+
+	for ( ; frame; frame = frame->parent )
+	{
+		for ( size_t i = frame->bound; i-- > 0; )
+		{
+			if ( frame->func->params_[i] == code.name )
+			{
+				ret = frame->args[i];
+				return true;
+			}
+		}
+	}
+
+	ret = symbols.getSymbol( code.name );
+	if ( ret.type != ARG_UNDEF )
+		return true;
+	if ( code.arg.type == ARG_UNDEF )
+		return false;
+	ret = code.arg;
+	return true;
+}
+
+inline bool Expression::run( const ExprFrame *outer, size_t calls, Arg &ret ) const
+{
+	if ( code_.empty() || calls > CALLS )
+		return false;
+
+	Arg stack[STACK];
+	size_t n = 0;
+	ExprFrame frames[STACK];	// calls whose arguments are being evaluated
+	size_t f = 0;
+
+	for ( size_t i=0; i<code_.size(); ++i )
+	{
+		const ExprCode &code = code_[i];
+		const ExprFrame *frame = f ? &frames[f - 1] : outer;
+		switch ( code.op )
+		{
+		case EXPR_VALUE:
+			stack[n++] = code.arg;
+			break;
+
+		case EXPR_PC:
+			stack[n] = code.arg;
+			stack[n++].data = pc;
+			break;
+
+		case EXPR_NAME:
+			if ( !lookup( code, frame, stack[n++] ) )
+				return false;
+			break;
+
+		case EXPR_PARAM:
+			if ( f )	// the arguments of a call may hide it
+			{
+				if ( !lookup( code, frame, stack[n++] ) )
+					return false;
+			}
+			else
+				stack[n++] = outer->args[code.arg.data];
+			break;
+
+		case EXPR_ARGS:
+			{
+				// a name defined otherwise, not a function: the parser
+				// reports the parenthesis
+				Arg sym;
+				if ( lookup( code, frame, sym ) )
+					return false;
+				const FunctionCode *func = expressions.function( code.name );
+				if ( !func || func->params_.size() != code.arg.data || f == STACK )
+					return false;
+				ExprFrame call = { func, &stack[n], 0, frame };
+				frames[f++] = call;
+			}
+			break;
+
+		case EXPR_ARG:
+			if ( !stack[n - 1].str )
+				stack[n - 1].str = text_;
+			++frames[f - 1].bound;
+			break;
+
+		case EXPR_CALL:
+			{
+				const ExprFrame &call = frames[f - 1];
+				Arg result;
+				if ( !call.func->body_.run( &call, calls + 1, result ) )
+					return false;
+				if ( !result.str )
+					result.str = call.func->body_.text_;
+				n -= call.bound;
+				stack[n++] = result;
+				--f;
+			}
+			break;
+
+		default:
+			{
+				Arg &lhs = stack[n - 2];
+				const Arg &rhs = stack[--n];
+				if ( !lhs.undef )
+					lhs.undef = rhs.undef;
+				if ( lhs.type == ARG_TEXT && rhs.type == ARG_IMM && lhs.gettext().size() == 1 )
+					lhs.type = rhs.type;
+				else if ( lhs.type != ARG_IMM || rhs.type != ARG_IMM )
+					return false;
+				if ( !apply( code.op, lhs.data, rhs.data ) )
+					return false;
+			}
+		}
+	}
+
+	ret = stack[0];
+	return true;
+}
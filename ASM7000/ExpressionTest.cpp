@@ -0,0 +1,172 @@
+#include "Parser.h"
+
+#include <iostream>
+
+Log log;
+StringPool stringpool;
+Symbols symbols;
+Expressions expressions;
+word pc;
+FunctionSeq_t functions;
+Fixups fixups;
+
+// The compiled code evaluates as the parser does, or leaves it to the parser.
+int compileTest( const string &expr, bool compiled )
+{
+	Expression code = Parser( expr ).compile();
+	if ( code.compiled() != compiled )
+	{
+		cerr << "compileTest failed [" << expr << "]: compiled " << code.compiled() << endl;
+		return 1;
+	}
+
+	Arg ret;
+	if ( code.evaluate( ret ) )
+	{
+		Parser parser( expr );
+		Arg expected = parser.parse();
+		if ( ret.type != expected.type || ret.data != expected.data || ret.str != expected.str
+			|| ret.text != expected.text || ret.undef != expected.undef )
+		{
+			cerr << "compileTest failed [" << expr << "]: got " << ret.data << " expected " << expected.data << endl;
+			return 1;
+		}
+	}
+	log.clear();
+
+	return 0;
+}
+
+int evaluateTest( const string &expr, bool evaluated, ArgType type, word data )
+{
+	Arg ret = { ARG_NONE, 0, 0, 0, 0 };
+	if ( Parser( expr ).compile().evaluate( ret ) != evaluated || ( evaluated && ( ret.type != type || ret.data != data ) ) )
+	{
+		cerr << "evaluateTest failed [" << expr << "]: got [" << ArgTypes::get(ret.type) << "] " << ret.data << endl;
+		return 1;
+	}
+
+	return 0;
+}
+
+// name: params,...,body as the FUNCTION directive
+int defineTest( const string &name, const string &params, const string &body )
+{
+	vector< string > def = Strings::split( params, "," );
+	def.push_back( body );
+	Function func( name, def );
+	functions[name] = func;
+	expressions.define( name, func.params_, Parser( func.expr_ ).compile() );
+	return 0;
+}
+
+// A call evaluates as the parser does, or the parser evaluates it.
+int callTest( const string &expr, bool evaluated, word expected )
+{
+	Arg ret;
+	if ( Parser( expr ).compile().evaluate( ret ) != evaluated )
+	{
+		cerr << "callTest failed [" << expr << "]: evaluated " << !evaluated << endl;
+		return 1;
+	}
+
+	if ( !evaluated )
+		return 0;
+
+	Parser parser( expr );
+	Arg arg = parser.parse();
+	log.clear();
+	if ( ( ret.data != expected || arg.data != expected || ret.str != arg.str ) )
+	{
+		cerr << "callTest failed [" << expr << "]: got " << ret.data << " and " << arg.data << endl;
+		return 1;
+	}
+
+	return 0;
+}
+
+int main()
+{
+	log.setEnabled( true );
+	symbols.beginSymbols();
+
+	Arg three = { ARG_IMM, 3, stringpool.intern( "THREE" ), 0, 0 };
+	symbols.addSymbol( "THREE", three );
+	pc = 0x1000;
+
+	int ret = 0;
+	ret += compileTest( "123", true );
+	ret += compileTest( ">7F", true );
+	ret += compileTest( "3-(2+1)", true );
+	ret += compileTest( " 3 - ( 2 + 1 ) ", true );
+	ret += compileTest( "0F50H>>4|1<<8", true );
+	ret += compileTest( "THREE*THREE%4", true );
+	ret += compileTest( "$+THREE", true );
+	ret += compileTest( "'A'+1", true );
+	ret += compileTest( "'\\''", true );
+	ret += compileTest( "R12", true );
+	ret += compileTest( "3+", true );
+
+	ret += compileTest( "SUM(1,2)", true );
+	ret += compileTest( "SUM(1,2", false );
+	ret += compileTest( "SUM(1,,2)", false );
+	ret += compileTest( "3 DUP 7", false );
+	ret += compileTest( "3<2", false );
+	ret += compileTest( "3)", false );
+	ret += compileTest( "#3", false );
+
+	string deep = "1";
+	for ( int i=1; i<Expression::STACK; ++i )
+		deep = "1+(" + deep + ")";
+	ret += compileTest( deep, true );
+	ret += compileTest( "1+(" + deep + ")", false );	// too deep
+
+	ret += evaluateTest( "$+THREE", true, ARG_IMM, 0x1003 );
+	ret += evaluateTest( "'A'+1", true, ARG_IMM, 'B' );
+	ret += evaluateTest( "P3", true, ARG_PORT, 0x103 );
+	ret += evaluateTest( "LATER+1", false, ARG_NONE, 0 );
+	ret += evaluateTest( "'AB'+1", false, ARG_NONE, 0 );
+	ret += evaluateTest( "R1+1", false, ARG_NONE, 0 );
+	ret += evaluateTest( "1/0", false, ARG_NONE, 0 );
+
+	// functions: the arguments in slots, visible by name to the calls they
+	// make, as the parser defines them as local symbols
+	ret += defineTest( "SUM", "X,Y", "X+Y" );
+	ret += defineTest( "TWICE", "X", "SUM(X,X)" );
+	ret += defineTest( "OUTER", "X", "INNER(1)" );
+	ret += defineTest( "INNER", "Y", "X+Y" );
+	ret += defineTest( "SWAP", "Y,X", "SUM(X,Y)-Y" );
+	ret += defineTest( "AGAIN", "X", "AGAIN(X)" );
+	ret += callTest( "SUM(1,2)", true, 3 );
+	ret += callTest( "SUM(SUM(1,2),THREE)+1", true, 7 );
+	ret += callTest( "TWICE(TWICE(THREE))", true, 12 );
+	ret += callTest( "OUTER(10)", true, 11 );
+	ret += callTest( "SUM(5,SUM(1,X))", true, 7 );
+	ret += callTest( "SWAP(5,7)", true, 7 );
+	ret += callTest( "SUM(1)", false, 0 );
+	ret += callTest( "THREE(1)", false, 0 );
+	ret += callTest( "NONE(1)", false, 0 );
+	ret += callTest( "INNER(1)", false, 0 );
+	ret += callTest( "AGAIN(1)", false, 0 );
+
+	// the names are looked up when the code runs
+	Expression later = Parser( "LATER+1" ).compile();
+	Arg four = { ARG_IMM, 4, 0, 0, 0 };
+	symbols.addSymbol( "LATER", four );
+	Arg arg;
+	ret += ( !later.evaluate( arg ) || arg.data != 5 );
+	four.data = 40;
+	symbols.addSymbol( "LATER", four );
+	ret += ( !later.evaluate( arg ) || arg.data != 41 );
+
+	// cached by text: the operands share their code
+	Parser::getarg( "THREE+1" );
+	size_t size = expressions.size();
+	Arg a = Parser::getarg( "%THREE+1" );
+	Arg b = Parser::getarg( "@THREE+1" );
+	ret += ( expressions.size() != size || a.data != 4 || b.data != 4 || b.type != ARG_DIR );
+
+	symbols.endSymbols();
+
+	return ret;
+}
@@ -1,32 +1,46 @@
 #pragma once
 
 #include "Source_I.h"
-
-#include <fstream>
+#include "SourceCache.h"
 
 class FileSource : public Source_I
 {
 public:
 	FileSource( const string &name )
+	: data_( sourcecache.get( name ) )
+	{
+		fail_ = !data_;
+		num_ = 0;
+		name_ = name;
+	}
+
+	FileSource( const string &name, const FileData *data )
+	: data_( data )
 	{
-		pIn_ = new ifstream( name.data() );
-		fail_ = !*pIn_;
+		fail_ = !data_;
 		num_ = 0;
 		name_ = name;
 	}
 
 	virtual ~FileSource()
 	{
-		delete pIn_;
 	}
 
 	virtual string getline()
 	{
-		fail_ = !pIn_->getline( buf_, sizeof buf_ );
-		if ( fail_ )
-			return "";
-		++num_;
-		return buf_;
+		return getlineview().str();
+	}
+
+	// Returns the next line as a span into the cached file contents, without
+	// its CR/LF terminator. No copy and no length limit.
+	virtual StringView getlineview()
+	{
+		if ( !data_ || num_ >= data_->lines() )
+		{
+			fail_ = true;
+			return StringView();
+		}
+		return data_->line( num_++ );
 	}
 
 	virtual bool operator!()
@@ -36,8 +50,7 @@ public:
 
 	virtual void rewind()
 	{
-		pIn_->clear();
-		pIn_->seekg(0, ios::beg);
+		fail_ = !data_;
 		num_ = 0;
 	}
 
@@ -57,10 +70,8 @@ public:
 	}
 
 private:
+	const FileData *data_;
 	string name_;
-	char buf_[255];
-	ifstream *pIn_;
 	bool fail_;
-	int num_;
+	size_t num_;
 };
-
@@ -1,6 +1,47 @@
 #include "FileSource.h"
 
-int main()
+#include <fstream>
+#include <iostream>
+
+SourceCache sourcecache;
+
+int getlineTest( FileSource &src, const string &expected )
 {
+	string ret = src.getline();
+	if ( !src || ret != expected )
+	{
+		cerr << "Test failed: expected [" << expected << "] but got [" << ret << "]" << endl;
+		return 1;
+	}
 	return 0;
 }
+
+int main()
+{
+	const string name = "FileSourceTest.tmp";
+	const string longline( 1000, 'X' );
+	{
+		ofstream out( name.data(), ios::binary );
+		out << "\tNOP\r\n" << longline << "\n\n" << "\tEND";
+	}
+
+	int ret = 0;
+	FileSource src( name );
+	for ( int pass=1; pass<=2; ++pass )
+	{
+		src.rewind();
+		ret += getlineTest( src, "\tNOP" );
+		ret += getlineTest( src, longline );
+		ret += getlineTest( src, "" );
+		ret += getlineTest( src, "\tEND" );
+		src.getline();
+		ret += !!src;
+		ret += src.linenum() != 4;
+	}
+
+	FileSource again( name );
+	ret += getlineTest( again, "\tNOP" );
+
+	remove( name.data() );
+	return ret;
+}
@@ -0,0 +1,137 @@
+#pragma once
+
+#include "TypeDefs.h"
+
+#include <string>
+#include <vector>
+#include <map>
+
+using namespace std;
+
+/////// FIXUPS ////////////////////////////////////////////////////////////////
+
+// Forward references in single-pass mode: the operand is emitted as a
+// placeholder and patched in the image once the symbol gets defined.
+
+enum FixupKind
+{
+	FIX_BYTE = 0,	// 8-bit value, getbyte()
+	FIX_NUM,		// register or port number, getnum()
+	FIX_WORD,		// 16-bit address, gethigh() and getlow()
+	FIX_REL8		// 8-bit offset from base, getoffset()
+};
+
+struct Fixup
+{
+	FixupKind	kind;
+	size_t		index;	// in the image (staged: in the instruction)
+	word		base;	// FIX_REL8: address the offset is relative to
+	word		pc;		// value of $
+	string		expr;	// operand to evaluate
+};
+
+typedef multimap< string, Fixup >	fixups_t;
+typedef fixups_t::iterator			fixupptr_t;
+
+class Fixups
+{
+public:
+	Fixups()
+	: enabled_( false )
+	{
+	}
+
+	void setEnabled( bool flag )
+	{
+		enabled_ = flag;
+	}
+
+	bool isEnabled() const
+	{
+		return enabled_;
+	}
+
+	// Records an undefined symbol found while evaluating an operand of the
+	// current line, returns its handle (never 0) to keep in Arg::undef.
+	int undefined( const string &name )
+	{
+		undefined_.push_back( name );
+		return int( undefined_.size() );
+	}
+
+	const string &undefinedName( int undef ) const
+	{
+		return undefined_[undef - 1];
+	}
+
+	const vector< string > &undefinedNames() const
+	{
+		return undefined_;
+	}
+
+	// Forgets the undefined symbols recorded since undefinedNames().size()
+	// was count.
+	void dropUndefined( size_t count )
+	{
+		undefined_.resize( count );
+	}
+
+	// Adds a placeholder at pos in the current instruction, waiting for the
+	// undefined symbol of the operand.
+	void add( FixupKind kind, size_t pos, word base, word pc, const string &expr, int undef )
+	{
+		Fixup fixup = { kind, pos, base, pc, expr };
+		staged_.push_back( make_pair( undefinedName( undef ), fixup ) );
+	}
+
+	bool hasStaged() const
+	{
+		return !staged_.empty();
+	}
+
+	// The current instruction is stored at index in the image.
+	void commit( size_t index )
+	{
+		for ( size_t i=0; i<staged_.size(); ++i )
+		{
+			staged_[i].second.index += index;
+			pending_.insert( staged_[i] );
+		}
+		staged_.clear();
+	}
+
+	// Starts a new line.
+	void clearLine()
+	{
+		undefined_.clear();
+		staged_.clear();
+	}
+
+	// Moves out the fixups waiting for a symbol.
+	void take( const string &name, vector< Fixup > &fixups )
+	{
+		pair< fixupptr_t, fixupptr_t > range = pending_.equal_range( name );
+		for ( fixupptr_t it = range.first; it != range.second; ++it )
+			fixups.push_back( it->second );
+		pending_.erase( range.first, range.second );
+	}
+
+	// Puts back a fixup still waiting for a symbol.
+	void wait( const string &name, const Fixup &fixup )
+	{
+		pending_.insert( make_pair( name, fixup ) );
+	}
+
+	fixups_t &pending()
+	{
+		return pending_;
+	}
+
+private:
+	bool enabled_;
+	vector< string > undefined_;
+	vector< pair< string, Fixup > > staged_;
+	fixups_t pending_;
+};
+
+extern Fixups fixups;
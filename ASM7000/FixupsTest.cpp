@@ -0,0 +1,14 @@
+#include "Fixups.h"
+
+Fixups fixups;
+
+int main()
+{
+	vector< Fixup > waiting;
+	fixups.clearLine();
+	int undef = fixups.undefined( "FWD" );
+	fixups.add( FIX_WORD, 1, 0, 0xF000, "@FWD", undef );
+	fixups.commit( 16 );
+	fixups.take( "FWD", waiting );
+	return ( waiting.size() != 1 ) + ( waiting[0].index != 17 ) + !fixups.pending().empty();
+}
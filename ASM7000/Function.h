@@ -17,6 +17,7 @@ public:
 	Function()
 	{}
 
+	// def: the operands of the FUNCTION line, already folded by the tokenizer
 	Function( const string &name, const vector< string > &def )
 	{
 		if ( name.empty() )
@@ -30,11 +31,8 @@ public:
 		else
 		{
 			name_ = name;
-			for ( int i=0; i<def.size()-1; ++i )
-			{
-				params_.push_back( Strings::touppernotquoted( def[i] ) );
-			}
-			expr_ = Strings::touppernotquoted( def.back() );
+			params_.assign( def.begin(), def.end() - 1 );
+			expr_ = def.back();
 			log.debug( "Function %s = %s", name_.data(), expr_.data() );
 		}
 	}
@@ -44,7 +42,7 @@ public:
 	string expr_;
 };
 
-typedef map< string, Function > FunctionSeq_t;
+typedef map< string, Function, less<> > FunctionSeq_t;	// looked up by StringView too
 typedef FunctionSeq_t::const_iterator FunctionPtr_t;
 
 extern FunctionSeq_t functions;
@@ -0,0 +1,99 @@
+#pragma once
+
+#include "SourceCache.h"
+
+#include <map>
+#include <set>
+
+using namespace std;
+
+/////// INCLUDE GUARD /////////////////////////////////////////////////////////
+
+// Files already included in the current pass, by canonical path and by
+// contents, so that a copy of the same file under another name is
+// recognized too. A file is skipped when it was marked by ONCE, or when
+// any file already included is skipped (option -NR).
+class IncludeGuard
+{
+public:
+	IncludeGuard()
+	: all_( false )
+	{
+	}
+
+	// Skips every file already included, not only those marked by ONCE.
+	void setAll( bool flag )
+	{
+		all_ = flag;
+	}
+
+	// Starts a new pass.
+	void clear()
+	{
+		included_.clear();
+		once_.clear();
+	}
+
+	// Returns true if the file must not be included again.
+	bool skip( const FileData *data ) const
+	{
+		if ( !data )
+			return false;
+		if ( all_ && contains( included_, data ) )
+			return true;
+		return contains( once_, data );
+	}
+
+	void included( const FileData *data )
+	{
+		if ( data && all_ )
+			insert( included_, data );
+	}
+
+	// ONCE: the file is included once per pass.
+	void once( const FileData *data )
+	{
+		if ( data )
+			insert( once_, data );
+	}
+
+private:
+	struct Keys
+	{
+		set< string > paths;
+		multimap< size_t, const FileData* > sizes;
+
+		void clear()
+		{
+			paths.clear();
+			sizes.clear();
+		}
+	};
+
+	// Same path, or same contents: compared only with the files of the same
+	// size, by hash and then byte for byte.
+	static bool contains( const Keys &keys, const FileData *data )
+	{
+		if ( keys.paths.count( data->path() ) )
+			return true;
+		StringView contents = data->contents();
+		typedef multimap< size_t, const FileData* >::const_iterator iterator;
+		pair< iterator, iterator > range = keys.sizes.equal_range( contents.size() );
+		for ( iterator it = range.first; it != range.second; ++it )
+		{
+			if ( it->second->hash() == data->hash() && it->second->contents() == contents )
+				return true;
+		}
+		return false;
+	}
+
+	static void insert( Keys &keys, const FileData *data )
+	{
+		if ( keys.paths.insert( data->path() ).second )
+			keys.sizes.insert( make_pair( data->contents().size(), data ) );
+	}
+
+	bool all_;
+	Keys included_;
+	Keys once_;
+};
@@ -0,0 +1,47 @@
+#include "IncludeGuard.h"
+
+#include <fstream>
+#include <cstdio>
+
+SourceCache sourcecache;
+
+int main()
+{
+	const char *copy = "IncludeGuardTest.tmp";
+	const char *other = "IncludeGuardTest2.tmp";
+	{
+		ifstream in( "IncludeGuardTest.cpp", ios::binary );
+		ofstream out( copy, ios::binary );
+		out << in.rdbuf();
+		ofstream out2( other, ios::binary );
+		out2 << string( in.tellg(), ' ' );	// same size, other contents
+	}
+
+	const FileData *data = sourcecache.get( "IncludeGuardTest.cpp" );
+	const FileData *same = sourcecache.get( copy );
+	const FileData *differ = sourcecache.get( other );
+
+	IncludeGuard guard;
+	int ret = 0;
+
+	guard.included( data );
+	ret += guard.skip( data );			// only ONCE files are skipped
+	guard.once( data );
+	ret += !guard.skip( data );
+	ret += !guard.skip( same );			// same contents
+	ret += guard.skip( differ );		// same size only
+	guard.clear();
+	ret += guard.skip( data );
+
+	guard.setAll( true );
+	guard.included( data );
+	ret += !guard.skip( same );
+	ret += guard.skip( 0 );
+
+	ret += guard.skip( differ );
+
+	remove( copy );
+	remove( other );
+
+	return ret;
+}
@@ -0,0 +1,176 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <unordered_set>
+#include <mutex>
+#include <cctype>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <dirent.h>
+#endif
+
+using namespace std;
+
+/////// INCLUDE PATH //////////////////////////////////////////////////////////
+
+// Resolves include file names against the current directory, then the
+// search directories in the order given. The listing of each directory is
+// read once, on first use, into a hash index, so resolving a name is a
+// lookup per directory instead of a failing open() per directory.
+class IncludePath
+{
+public:
+	// Adds a search directory.
+	void add( const string &dir )
+	{
+		lock_guard< mutex > lock( mutex_ );
+		dirs_.push_back( Dir() );
+		dirs_.back().path = dir;
+	}
+
+	bool empty() const
+	{
+		return dirs_.empty();
+	}
+
+	// Returns the path of the file to open: the name itself if it is in the
+	// current directory, isn't found or there are no search directories.
+	string find( const string &name )
+	{
+		if ( dirs_.empty() || name.empty() || isabsolute( name ) )
+			return name;
+
+		lock_guard< mutex > lock( mutex_ );
+
+		if ( hasdir( name ) )
+		{
+			// relative path with directories: not in the indexes
+			struct stat st;
+			if ( !stat( name.data(), &st ) )
+				return name;
+			for ( size_t i=0; i<dirs_.size(); ++i )
+			{
+				string path = join( dirs_[i].path, name );
+				if ( !stat( path.data(), &st ) )
+					return path;
+			}
+			return name;
+		}
+
+		if ( contains( current_, name ) )
+			return name;
+		for ( size_t i=0; i<dirs_.size(); ++i )
+		{
+			if ( contains( dirs_[i], name ) )
+				return join( dirs_[i].path, name );
+		}
+		return name;
+	}
+
+private:
+	typedef unordered_set< string > names_t;
+
+	struct Dir
+	{
+		Dir() : indexed( false ) {}
+
+		string	path;
+		bool	indexed;
+		names_t	names;
+	};
+
+	bool contains( Dir &dir, const string &name )
+	{
+		if ( !dir.indexed )
+		{
+			scan( dir );
+			dir.indexed = true;
+		}
+		return dir.names.count( key( name ) ) != 0;
+	}
+
+	static void scan( Dir &dir )
+	{
+		string path = dir.path.empty() ? "." : dir.path;
+#ifdef _WIN32
+		WIN32_FIND_DATAA data;
+		HANDLE find = FindFirstFileA( join( path, "*" ).data(), &data );
+		if ( find == INVALID_HANDLE_VALUE )
+			return;
+		do
+		{
+			if ( !( data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY ) )
+				dir.names.insert( key( data.cFileName ) );
+		}
+		while ( FindNextFileA( find, &data ) );
+		FindClose( find );
+#else
+		DIR *d = opendir( path.data() );
+		if ( !d )
+			return;
+		while ( struct dirent *ent = readdir( d ) )
+			dir.names.insert( key( ent->d_name ) );
+		closedir( d );
+#endif
+	}
+
+	// Names are case-insensitive on Windows.
+	static string key( const string &name )
+	{
+#ifdef _WIN32
+		string ret = name;
+		for ( size_t i=0; i<ret.size(); ++i )
+			ret[i] = toupper( ret[i] );
+		return ret;
+#else
+		return name;
+#endif
+	}
+
+	static bool issep( char c )
+	{
+#ifdef _WIN32
+		return c == '/' || c == '\\' || c == ':';
+#else
+		return c == '/';
+#endif
+	}
+
+	static bool hasdir( const string &name )
+	{
+		for ( size_t i=0; i<name.size(); ++i )
+		{
+			if ( issep( name[i] ) )
+				return true;
+		}
+		return false;
+	}
+
+	static bool isabsolute( const string &name )
+	{
+#ifdef _WIN32
+		return issep( name[0] ) || ( name.size() > 1 && name[1] == ':' );
+#else
+		return issep( name[0] );
+#endif
+	}
+
+	static string join( const string &dir, const string &name )
+	{
+		if ( dir.empty() )
+			return name;
+		if ( issep( dir[dir.size()-1] ) )
+			return dir + name;
+		return dir + "/" + name;
+	}
+
+	Dir current_;
+	vector< Dir > dirs_;
+	mutex mutex_;
+};
+
+extern IncludePath includepath;
@@ -0,0 +1,30 @@
+#include "IncludePath.h"
+
+#include <iostream>
+
+IncludePath includepath;
+
+int findTest( const string &name, const string &expected )
+{
+	string ret = includepath.find( name );
+	if ( ret != expected )
+	{
+		cerr << "Test failed: " << name << ": expected [" << expected << "] but got [" << ret << "]" << endl;
+		return 1;
+	}
+	return 0;
+}
+
+int main()
+{
+	int ret = findTest( "IncludePathTest.cpp", "IncludePathTest.cpp" );
+
+	includepath.add( "." );
+	includepath.add( "none/" );
+
+	return	ret
+		+	findTest( "IncludePathTest.cpp", "IncludePathTest.cpp" )
+		+	findTest( "IncludePath.none", "IncludePath.none" )
+		+	findTest( "../ASM7000/IncludePath.h", "../ASM7000/IncludePath.h" )
+		+	( includepath.empty() );
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include "StringView.h"
+
+#include <cctype>
+
+/////// LINE FILTER ///////////////////////////////////////////////////////////
+
+// Classifies raw source lines before tokenizing, to skip the lines that
+// can't do anything: blank and comment-only lines, and the lines of a
+// false conditional block other than the conditional directives and REPT.
+class LineFilter
+{
+public:
+	// Blank line or comment-only line: no label, operation nor operand.
+	static bool isblank( const StringView &line )
+	{
+		const char *p = line.begin();
+		const char *end = line.end();
+		while ( p < end && issep( *p ) )
+			++p;
+		return p == end || !*p || *p == ';';
+	}
+
+	// Line of a false conditional block that can be skipped: its operation
+	// is neither a conditional directive nor REPT. Lines with a quote, an
+	// escape or a comment sign in their label or operation are tokenized.
+	static bool isinactive( const StringView &line )
+	{
+		const char *p = line.begin();
+		const char *end = line.end();
+		if ( !skiptoken( p, end ) )
+			return false;
+		while ( p < end && issep( *p ) )
+			++p;
+		const char *op = p;
+		if ( !skiptoken( p, end ) )
+			return false;
+		return !isconditional( StringView( op, p - op ) );
+	}
+
+	static bool isconditional( const StringView &op )
+	{
+		switch ( op.size() )
+		{
+		case 2:
+			return is( op, "IF" );
+		case 3:
+			return is( op, "$IF" );
+		case 4:
+			return is( op, "COND" ) || is( op, "ELSE" ) || is( op, "REPT" );
+		case 5:
+			return is( op, "$ELSE" ) || is( op, "ENDIF" ) || is( op, "$ENDC" );
+		case 6:
+			return is( op, "$ENDIF" );
+		}
+		return false;
+	}
+
+private:
+	static bool issep( char c )
+	{
+		return c == '\t' || c == ' ' || c == ':';
+	}
+
+	// Skips a token, returns false if it needs the tokenizer.
+	static bool skiptoken( const char *&p, const char *end )
+	{
+		for ( ; p < end && !issep( *p ); ++p )
+		{
+			switch ( *p )
+			{
+			case 0:
+			case ';':
+			case '\'':
+			case '"':
+			case '\\':
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// Case-insensitive compare to an upper case name of the same size.
+	static bool is( const StringView &op, const char *name )
+	{
+		for ( size_t i=0; i<op.size(); ++i )
+		{
+			if ( toupper( op[i] ) != name[i] )
+				return false;
+		}
+		return true;
+	}
+};
@@ -0,0 +1,32 @@
+#include "LineFilter.h"
+
+#include <iostream>
+
+int filterTest( const char *line, bool blank, bool inactive )
+{
+	if ( LineFilter::isblank( line ) != blank || LineFilter::isinactive( line ) != inactive )
+	{
+		cerr << "Test failed: [" << line << "]" << endl;
+		return 1;
+	}
+	return 0;
+}
+
+int main()
+{
+	return	filterTest( "", true, true )
+		+	filterTest( " \t", true, true )
+		+	filterTest( "; comment", true, false )
+		+	filterTest( "\t; comment", true, false )
+		+	filterTest( ":;odd", true, false )
+		+	filterTest( "LBL\tMOV\tR1,A", false, true )
+		+	filterTest( "\tDB\t'IF'", false, true )
+		+	filterTest( "\tif\t1", false, false )
+		+	filterTest( "\t$ELSE", false, false )
+		+	filterTest( "\tEndIf", false, false )
+		+	filterTest( "\t$ENDC", false, false )
+		+	filterTest( "\tREPT\t3", false, false )
+		+	filterTest( "\tENDM", false, true )
+		+	filterTest( "X;Y\tDB\t3", false, false )
+		+	filterTest( "'A B'\tIF", false, false );
+}
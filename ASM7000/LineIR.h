@@ -0,0 +1,178 @@
+#pragma once
+
+#include "ArgType.h"
+#include "Opcodes.h"
+#include "StringView.h"
+
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/////// LINE IR ///////////////////////////////////////////////////////////////
+
+// Tokenized source line, recorded by pass 1 and replayed by pass 2, which
+// then skips the tokenizing and the lookup of the operation. The operands
+// are evaluated again, their symbols being resolved in pass 2 only; their
+// kind and the length of the line found by pass 1 check it.
+struct IRLine
+{
+	enum
+	{
+		ISLINE	= 1,	// a line was read (otherwise: end of a source)
+		PUSH	= 2,	// an include or a REPT expansion starts after this line
+		NOFILE	= 4,	// the include file couldn't be opened
+		SKIPPED	= 8,	// the include file was already included
+		FILTERED = 16	// false conditional block line, not tokenized
+	};
+
+	struct Span
+	{
+		size_t pos;
+		size_t size;
+	};
+
+	size_t	num;
+	int		flags;
+	Span	line;
+	Span	label;
+	Span	op;
+	Span	argstr;
+	size_t	args;		// index of the first operand
+	size_t	nargs;		// number of operands
+	const Opcode *opcode;	// operation looked up by pass 1
+	OpHandler handler;
+	size_t	size;		// bytes of the line in pass 1
+};
+
+struct IROperand
+{
+	IRLine::Span text;
+	strid_t	id;			// interned text
+	ArgType	type;		// kind in pass 1
+};
+
+class LineIR
+{
+public:
+	LineIR()
+	: recorded_( false ), pos_( 0 )
+	{
+	}
+
+	void add( const string &line, size_t num, bool isline, const string &label,
+		const string &op, const string &argstr, const vector< string > &args )
+	{
+		IRLine irline;
+		irline.num = num;
+		irline.flags = isline ? IRLine::ISLINE : 0;
+		irline.line = span( line );
+		irline.label = span( label );
+		irline.op = span( op );
+		irline.argstr = span( argstr );
+		irline.args = args_.size();
+		irline.nargs = args.size();
+		irline.opcode = 0;
+		irline.handler = OP_NONE;
+		irline.size = 0;
+		for ( size_t i=0; i<args.size(); ++i )
+		{
+			IROperand arg = { span( args[i] ), stringpool.intern( args[i] ), ARG_NONE };
+			args_.push_back( arg );
+		}
+		lines_.push_back( irline );
+	}
+
+	IRLine &back()
+	{
+		return lines_.back();
+	}
+
+	// Called at the end of pass 1.
+	void setRecorded()
+	{
+		recorded_ = true;
+	}
+
+	bool recorded() const
+	{
+		return recorded_;
+	}
+
+	void rewind()
+	{
+		pos_ = 0;
+	}
+
+	bool eof() const
+	{
+		return pos_ >= lines_.size();
+	}
+
+	const IRLine &next()
+	{
+		return lines_[pos_++];
+	}
+
+	// Skips the lines of a source pushed by the previous line, up to and
+	// including its end.
+	void skipsource()
+	{
+		int depth = 0;
+		while ( !eof() )
+		{
+			const IRLine &irline = next();
+			if ( irline.flags & IRLine::PUSH )
+				++depth;
+			else if ( !( irline.flags & IRLine::ISLINE ) && !depth-- )
+				break;
+		}
+	}
+
+	StringView text( const IRLine::Span &span ) const
+	{
+		return StringView( text_.data() + span.pos, span.size );
+	}
+
+	StringView arg( const IRLine &irline, size_t i ) const
+	{
+		return text( args_[irline.args + i].text );
+	}
+
+	IROperand &operand( const IRLine &irline, size_t i )
+	{
+		return args_[irline.args + i];
+	}
+
+	// Copies the fields of a line to the caller's strings, reusing their buffers.
+	void get( const IRLine &irline, string &line, string &label, string &op,
+		string &argstr, vector< string > &args ) const
+	{
+		assign( line, text( irline.line ) );
+		assign( label, text( irline.label ) );
+		assign( op, text( irline.op ) );
+		assign( argstr, text( irline.argstr ) );
+		args.resize( irline.nargs );
+		for ( size_t i=0; i<irline.nargs; ++i )
+			assign( args[i], arg( irline, i ) );
+	}
+
+private:
+	IRLine::Span span( const string &str )
+	{
+		IRLine::Span ret = { text_.size(), str.size() };
+		text_ += str;
+		return ret;
+	}
+
+	static void assign( string &str, const StringView &view )
+	{
+		str.assign( view.data(), view.size() );
+	}
+
+	string text_;
+	vector< IROperand > args_;
+	vector< IRLine > lines_;
+	bool recorded_;
+	size_t pos_;
+};
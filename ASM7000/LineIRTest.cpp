@@ -0,0 +1,41 @@
+#include "LineIR.h"
+
+#include <iostream>
+
+StringPool stringpool;
+
+int main()
+{
+	LineIR ir;
+	vector< string > args;
+	args.push_back( "R1" );
+	args.push_back( "A" );
+	ir.add( "LBL\tMOV\tr1,A", 1, true, "LBL", "MOV", "r1,A", args );
+	ir.add( "", 1, false, "", "", "", vector< string >() );
+	ir.setRecorded();
+
+	string line, label, op, argstr;
+	ir.rewind();
+	const IRLine &first = ir.next();
+	ir.get( first, line, label, op, argstr, args );
+	if ( line != "LBL\tMOV\tr1,A" || label != "LBL" || op != "MOV" || argstr != "r1,A"
+		|| args.size() != 2 || args[0] != "R1" || args[1] != "A" )
+	{
+		cerr << "Test failed: [" << line << "]" << endl;
+		return 1;
+	}
+	// operands interned, kinds and length left to the assembler
+	IROperand &r1 = ir.operand( first, 0 );
+	if ( stringpool.get( r1.id ) != "R1" || r1.type != ARG_NONE || first.opcode || first.size )
+	{
+		cerr << "Test failed: operand [" << stringpool.get( r1.id ) << "]" << endl;
+		return 1;
+	}
+	r1.type = ARG_REG;
+	if ( ir.operand( first, 0 ).type != ARG_REG || ir.operand( first, 1 ).type != ARG_NONE )
+		return 1;
+
+	const IRLine &second = ir.next();
+	ir.get( second, line, label, op, argstr, args );
+	return !line.empty() + !args.empty() + !!( second.flags & IRLine::ISLINE ) + !ir.eof();
+}
@@ -4,6 +4,7 @@
 
 #include "RefCounter.h"
 #include "Debug.h"
+#include "StringView.h"
 
 #include <string>
 #include <vector>
@@ -119,11 +120,16 @@ public:
 	}
 
 	string getline()
+	{
+		return getlineview().str();
+	}
+
+	StringView getlineview()
 	{
 		if ( !data )
 		{
 			CDBG << "getline(): !data" << endl;
-			return "";
+			return StringView();
 		}
 		CDBG << "getline(): data" << ( ( data->itText == data->text.end() ) ? "" : *(data->itText) ) << endl;
 		if ( data->itText == data->text.end() )
@@ -135,7 +141,7 @@ public:
 		if ( data->itText == data->text.end() )
 		{
 			data->eof = true;
-			return "";
+			return StringView();
 		}
 
 		return *(data->itText++);
@@ -151,6 +157,12 @@ public:
 		return data->type;
 	}
 
+	// Lines in the body.
+	size_t size() const
+	{
+		return data ? data->text.size() : 0;
+	}
+
 	void rept( int rept )
 	{
 		if ( !data )
@@ -23,6 +23,12 @@ public:
 		return macro_.getline();
 	}
 
+	virtual StringView getlineview()
+	{
+		CDBG << "macro getlineview()" << endl;
+		return macro_.getlineview();
+	}
+
 	virtual bool operator!()
 	{
 		CDBG << "macro operator!()" << endl;
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <string>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+/////// MAPPED FILE ///////////////////////////////////////////////////////////
+
+// Read-only view of a whole file mapped in memory.
+class MappedFile
+{
+public:
+	MappedFile( const string &name )
+	: data_( 0 ), size_( 0 ), fail_( true )
+	{
+#ifdef _WIN32
+		HANDLE hFile = CreateFileA( name.data(), GENERIC_READ, FILE_SHARE_READ, 0,
+			OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, 0 );
+		if ( hFile == INVALID_HANDLE_VALUE )
+			return;
+		LARGE_INTEGER size;
+		if ( GetFileSizeEx( hFile, &size ) )
+		{
+			fail_ = false;
+			size_ = size_t( size.QuadPart );
+			if ( size_ )
+			{
+				HANDLE hMap = CreateFileMappingA( hFile, 0, PAGE_READONLY, 0, 0, 0 );
+				if ( hMap )
+				{
+					data_ = (const char*)MapViewOfFile( hMap, FILE_MAP_READ, 0, 0, 0 );
+					CloseHandle( hMap );
+				}
+				fail_ = !data_;
+			}
+		}
+		CloseHandle( hFile );
+#else
+		int fd = open( name.data(), O_RDONLY );
+		if ( fd < 0 )
+			return;
+		struct stat st;
+		if ( !fstat( fd, &st ) && S_ISREG( st.st_mode ) )
+		{
+			fail_ = false;
+			size_ = size_t( st.st_size );
+			if ( size_ )
+			{
+				void *p = mmap( 0, size_, PROT_READ, MAP_PRIVATE, fd, 0 );
+				if ( p != MAP_FAILED )
+				{
+					madvise( p, size_, MADV_SEQUENTIAL );
+					data_ = (const char*)p;
+				}
+				fail_ = !data_;
+			}
+		}
+		close( fd );
+#endif
+		if ( fail_ )
+			size_ = 0;
+	}
+
+	~MappedFile()
+	{
+		if ( data_ )
+		{
+#ifdef _WIN32
+			UnmapViewOfFile( data_ );
+#else
+			munmap( (void*)data_, size_ );
+#endif
+		}
+	}
+
+	const char *data() const
+	{
+		return data_;
+	}
+
+	size_t size() const
+	{
+		return size_;
+	}
+
+	bool operator!() const
+	{
+		return fail_;
+	}
+
+private:
+	MappedFile( const MappedFile & );
+	MappedFile &operator=( const MappedFile & );
+
+	const char *data_;
+	size_t size_;
+	bool fail_;
+};
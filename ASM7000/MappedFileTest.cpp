@@ -0,0 +1,8 @@
+#include "MappedFile.h"
+
+int main()
+{
+	MappedFile file( "MappedFileTest.cpp" );
+	MappedFile none( "MappedFileTest.none" );
+	return !file.size() + !file + !!none;
+}
@@ -0,0 +1,259 @@
+#pragma once
+
+#include "StringView.h"
+
+#include <cstddef>
+
+/////// OPCODES ///////////////////////////////////////////////////////////////
+
+// Mnemonics and directives, with the handler that assembles them in main()
+// and its parameters. A mnemonic is found by a perfect hash computed at
+// compile time: adding one is adding an entry to the table (if the
+// static_assert then fails, search another OPCODE_SEED).
+
+enum OpHandler
+{
+	OP_NONE = 0,		// no operation
+	OP_UNKNOWN,			// unrecognized op-code
+	// preprocessing
+	OP_REPT,
+	OP_IF,
+	OP_ELSE,
+	OP_ENDIF,
+	OP_INCLUDE,
+	OP_ONCE,
+	// directives
+	OP_SAVE,
+	OP_RESTORE,
+	OP_CPU,
+	OP_PAGE,
+	OP_LISTING,
+	OP_FUNCTION,
+	OP_MACRO,
+	OP_ORG,
+	OP_EQU,
+	OP_END,
+	OP_MESSAGE,			// code: 0 error, 1 warning, 2 info
+	OP_ASSERT_EQUAL,
+	// data
+	OP_BYTE,
+	OP_DB,
+	OP_DS,
+	OP_TEXT,
+	OP_DATA,			// code: 1 for DW
+	// instructions
+	OP_MOV,
+	OP_MOVD,
+	OP_MOVP,
+	OP_XADDR,
+	OP_IMPLICIT,
+	OP_UNOP,
+	OP_BINOP,
+	OP_BINOP_P,
+	OP_JUMP,
+	OP_PUSHPOP,
+	OP_TRAP
+};
+
+struct Opcode
+{
+	const char	*name;
+	OpHandler	handler;
+	int			nargs;	// number of operands
+	int			code;	// opcode bits, or variant of the directive
+	bool		jump;	// the last operand is a short jump target
+};
+
+constexpr Opcode opcodes[] =
+{
+	{ "REPT",			OP_REPT,			0, 0x00, false },
+	{ "IF",				OP_IF,				0, 0x00, false },
+	{ "$IF",			OP_IF,				0, 0x00, false },
+	{ "COND",			OP_IF,				0, 0x00, false },
+	{ "ELSE",			OP_ELSE,			0, 0x00, false },
+	{ "$ELSE",			OP_ELSE,			0, 0x00, false },
+	{ "ENDIF",			OP_ENDIF,			0, 0x00, false },
+	{ "$ENDIF",			OP_ENDIF,			0, 0x00, false },
+	{ "$ENDC",			OP_ENDIF,			0, 0x00, false },
+	{ "COPY",			OP_INCLUDE,			0, 0x00, false },
+	{ "INCLUDE",		OP_INCLUDE,			0, 0x00, false },
+	{ "GET",			OP_INCLUDE,			0, 0x00, false },
+	{ "ONCE",			OP_ONCE,			0, 0x00, false },
+
+	{ "SAVE",			OP_SAVE,			0, 0x00, false },
+	{ "RESTORE",		OP_RESTORE,			0, 0x00, false },
+	{ "CPU",			OP_CPU,				0, 0x00, false },
+	{ "PAGE",			OP_PAGE,			0, 0x00, false },
+	{ "LISTING",		OP_LISTING,			0, 0x00, false },
+	{ "FUNCTION",		OP_FUNCTION,		0, 0x00, false },
+	{ "FUNC",			OP_FUNCTION,		0, 0x00, false },
+	{ "MACRO",			OP_MACRO,			0, 0x00, false },
+	{ "AORG",			OP_ORG,				1, 0x00, false },
+	{ "ORG",			OP_ORG,				1, 0x00, false },
+	{ "EQU",			OP_EQU,				1, 0x00, false },
+	{ "END",			OP_END,				0, 0x00, false },
+	{ "ERROR",			OP_MESSAGE,			1, 0x00, false },
+	{ "WARNING",		OP_MESSAGE,			1, 0x01, false },
+	{ "MESSAGE",		OP_MESSAGE,			1, 0x02, false },
+	{ "INFO",			OP_MESSAGE,			1, 0x02, false },
+	{ "ASSERT_EQUAL",	OP_ASSERT_EQUAL,	2, 0x00, false },
+
+	{ "BYTE",			OP_BYTE,			0, 0x00, false },
+	{ "DB",				OP_DB,				0, 0x00, false },
+	{ "DS",				OP_DS,				1, 0x00, false },
+	{ "TEXT",			OP_TEXT,			1, 0x00, false },
+	{ "DATA",			OP_DATA,			0, 0x00, false },
+	{ "DW",				OP_DATA,			0, 0x01, false },
+
+	// move
+	{ "MOV",			OP_MOV,				2, 0x00, false },
+	{ "MOVD",			OP_MOVD,			2, 0x00, false },
+	{ "MOVP",			OP_MOVP,			2, 0x00, false },
+	// memory access
+	{ "LDA",			OP_XADDR,			1, 0x0A, false },
+	{ "STA",			OP_XADDR,			1, 0x0B, false },
+	{ "BR",				OP_XADDR,			1, 0x0C, false },
+	{ "CMPA",			OP_XADDR,			1, 0x0D, false },
+	{ "CALL",			OP_XADDR,			1, 0x0E, false },
+	// implicit (no operands)
+	{ "NOP",			OP_IMPLICIT,		0, 0x00, false },
+	{ "IDLE",			OP_IMPLICIT,		0, 0x01, false },
+	{ "EINT",			OP_IMPLICIT,		0, 0x05, false },
+	{ "DINT",			OP_IMPLICIT,		0, 0x06, false },
+	{ "SETC",			OP_IMPLICIT,		0, 0x07, false },
+	{ "STSP",			OP_IMPLICIT,		0, 0x09, false },
+	{ "RETS",			OP_IMPLICIT,		0, 0x0A, false },
+	{ "RETI",			OP_IMPLICIT,		0, 0x0B, false },
+	{ "LDSP",			OP_IMPLICIT,		0, 0x0D, false },
+	{ "TSTA",			OP_IMPLICIT,		0, 0xB0, false },
+	{ "CLRC",			OP_IMPLICIT,		0, 0xB0, false },
+	{ "TSTB",			OP_IMPLICIT,		0, 0xC1, false },
+	// unary operations
+	{ "DEC",			OP_UNOP,			1, 0x02, false },
+	{ "INC",			OP_UNOP,			1, 0x03, false },
+	{ "INV",			OP_UNOP,			1, 0x04, false },
+	{ "CLR",			OP_UNOP,			1, 0x05, false },
+	{ "XCHB",			OP_UNOP,			1, 0x06, false },
+	{ "SWAP",			OP_UNOP,			1, 0x07, false },
+	{ "DECD",			OP_UNOP,			1, 0x0B, false },
+	{ "RR",				OP_UNOP,			1, 0x0C, false },
+	{ "RRC",			OP_UNOP,			1, 0x0D, false },
+	{ "RL",				OP_UNOP,			1, 0x0E, false },
+	{ "RLC",			OP_UNOP,			1, 0x0F, false },
+	{ "DJNZ",			OP_UNOP,			2, 0x0A, true  },
+	// binary operations
+	{ "AND",			OP_BINOP,			2, 0x03, false },
+	{ "OR",				OP_BINOP,			2, 0x04, false },
+	{ "XOR",			OP_BINOP,			2, 0x05, false },
+	{ "ADD",			OP_BINOP,			2, 0x08, false },
+	{ "ADC",			OP_BINOP,			2, 0x09, false },
+	{ "SUB",			OP_BINOP,			2, 0x0A, false },
+	{ "SBB",			OP_BINOP,			2, 0x0B, false },
+	{ "MPY",			OP_BINOP,			2, 0x0C, false },
+	{ "CMP",			OP_BINOP,			2, 0x0D, false },
+	{ "DAC",			OP_BINOP,			2, 0x0E, false },
+	{ "DSB",			OP_BINOP,			2, 0x0F, false },
+	{ "BTJO",			OP_BINOP,			3, 0x06, true  },
+	{ "BTJZ",			OP_BINOP,			3, 0x07, true  },
+	// binary operations on ports
+	{ "ANDP",			OP_BINOP_P,			2, 0x03, false },
+	{ "ORP",			OP_BINOP_P,			2, 0x04, false },
+	{ "XORP",			OP_BINOP_P,			2, 0x05, false },
+	{ "BTJOP",			OP_BINOP_P,			3, 0x06, true  },
+	{ "BTJZP",			OP_BINOP_P,			3, 0x07, true  },
+	// short jumps
+	{ "JMP",			OP_JUMP,			1, 0x00, false },
+	{ "JN",				OP_JUMP,			1, 0x01, false },
+	{ "JLT",			OP_JUMP,			1, 0x01, false },
+	{ "JZ",				OP_JUMP,			1, 0x02, false },
+	{ "JEQ",			OP_JUMP,			1, 0x02, false },
+	{ "JC",				OP_JUMP,			1, 0x03, false },
+	{ "JHS",			OP_JUMP,			1, 0x03, false },
+	{ "JP",				OP_JUMP,			1, 0x04, false },
+	{ "JGT",			OP_JUMP,			1, 0x04, false },
+	{ "JPZ",			OP_JUMP,			1, 0x05, false },
+	{ "JGE",			OP_JUMP,			1, 0x05, false },
+	{ "JNZ",			OP_JUMP,			1, 0x06, false },
+	{ "JNE",			OP_JUMP,			1, 0x06, false },
+	{ "JNC",			OP_JUMP,			1, 0x07, false },
+	{ "JL",				OP_JUMP,			1, 0x07, false },
+	// push/pop
+	{ "PUSH",			OP_PUSHPOP,			1, 0x08, false },
+	{ "POP",			OP_PUSHPOP,			1, 0x09, false },
+	// special
+	{ "TRAP",			OP_TRAP,			1, 0x00, false },
+};
+
+const size_t OPCODE_COUNT = sizeof opcodes / sizeof opcodes[0];
+const size_t OPCODE_SLOTS = 512;			// power of 2
+const unsigned OPCODE_SEED = 108927;		// no collision in OPCODE_SLOTS
+
+constexpr size_t opcodelength( const char *name )
+{
+	size_t len = 0;
+	while ( name[len] )
+		++len;
+	return len;
+}
+
+// FNV-1a from OPCODE_SEED, high half folded in.
+constexpr size_t opcodeslot( const char *name, size_t len )
+{
+	unsigned hash = OPCODE_SEED;
+	for ( size_t i=0; i<len; ++i )
+		hash = ( hash ^ (unsigned char)name[i] ) * 16777619u;
+	return ( hash ^ ( hash >> 16 ) ) & ( OPCODE_SLOTS - 1 );
+}
+
+// Index + 1 of the opcode in each slot, 0 if empty.
+struct OpcodeSlots
+{
+	unsigned char index[OPCODE_SLOTS];
+};
+
+constexpr bool opcodeperfect()
+{
+	OpcodeSlots slots = {};
+	for ( size_t i=0; i<OPCODE_COUNT; ++i )
+	{
+		size_t slot = opcodeslot( opcodes[i].name, opcodelength( opcodes[i].name ) );
+		if ( slots.index[slot] )
+			return false;
+		slots.index[slot] = (unsigned char)( i + 1 );
+	}
+	return true;
+}
+
+constexpr OpcodeSlots opcodeslots()
+{
+	OpcodeSlots slots = {};
+	for ( size_t i=0; i<OPCODE_COUNT; ++i )
+		slots.index[opcodeslot( opcodes[i].name, opcodelength( opcodes[i].name ) )] = (unsigned char)( i + 1 );
+	return slots;
+}
+
+static_assert( OPCODE_COUNT < 256, "opcode index doesn't fit in the slots" );
+static_assert( opcodeperfect(), "opcode hash collision: change OPCODE_SEED" );
+
+constexpr OpcodeSlots opcodeindex = opcodeslots();
+
+class Opcodes
+{
+public:
+	// Returns the opcode of a mnemonic or directive, 0 if unknown.
+	static const Opcode *find( const StringView &op )
+	{
+		unsigned char index = opcodeindex.index[opcodeslot( op.data(), op.size() )];
+		if ( !index )
+			return 0;
+		const Opcode *opcode = &opcodes[index - 1];
+		return op == opcode->name ? opcode : 0;
+	}
+
+	// Handler of the operation: OP_NONE if there is none, OP_UNKNOWN if it
+	// isn't recognized.
+	static OpHandler handler( const StringView &op, const Opcode *opcode )
+	{
+		return opcode ? opcode->handler : op.empty() ? OP_NONE : OP_UNKNOWN;
+	}
+};
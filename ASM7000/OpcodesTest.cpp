@@ -0,0 +1,24 @@
+#include "Opcodes.h"
+
+#include <string>
+
+using namespace std;
+
+int main()
+{
+	int ret = 0;
+
+	// every entry is found by its name
+	for ( size_t i=0; i<OPCODE_COUNT; ++i )
+		ret += ( Opcodes::find( opcodes[i].name ) != &opcodes[i] );
+
+	const Opcode *jeq = Opcodes::find( string( "JEQ" ) );
+	ret += !jeq || jeq->handler != OP_JUMP || jeq->code != 0x02;
+
+	ret += ( Opcodes::find( "MOVX" ) != 0 );
+	ret += ( Opcodes::find( "mov" ) != 0 );
+	ret += ( Opcodes::handler( "", 0 ) != OP_NONE );
+	ret += ( Opcodes::handler( "MOVX", 0 ) != OP_UNKNOWN );
+
+	return ret;
+}
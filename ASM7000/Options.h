@@ -19,6 +19,7 @@ struct Options
 	bool nolinenum;
 	bool nocerr;
 	bool page;
+	bool casesensitive;
 
 
 	Options()
@@ -33,6 +34,7 @@ struct Options
 	, nolinenum( false )
 	, nocerr( false )
 	, page( true )
+	, casesensitive( false )
 	{}
 };
 
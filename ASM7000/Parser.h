@@ -1,16 +1,20 @@
 #pragma once
 
+#include "Expression.h"
 #include "Symbols.h"
 #include "Function.h"
+#include "Fixups.h"
 #include "Log.h"
 
 extern word pc;
 
 
+// Evaluates an operand or an expression in place: names and operators are
+// compared in the source text, without copying it.
 class Parser
 {
 public:
-	Parser( const string &p_expr )
+	Parser( const StringView &p_expr )
 	: expr( p_expr ), len( p_expr.size() ), p( 0 )
 	{
 	}
@@ -21,22 +25,21 @@ public:
 			++p;
 	}
 
-	string parsename()
+	StringView parsename()
 	{
-		string ret;
 		skipblk();
+		size_t start = p;
 		while ( p < len )
 		{
 			char c = expr[p];
 			if ( c == '_' || c == '$' || isalnum( c ) )
 			{
 				++p;
-				ret += c;
 				continue;
 			}
 			break;
 		}
-		return ret;
+		return expr.substr( start, p - start );
 	}
 
 	word parsenum( int radix )
@@ -91,9 +94,46 @@ public:
 		}
 	}
 
+	// Quoted text, its first character as value.
+	void parsetext( Arg &ret )
+	{
+		char quote = expr[p++];
+		bool esc = false, first = true;
+		string text;
+
+		while ( p < len && ( esc || expr[p] != quote ) )
+		{
+			char ch = expr[p++];
+
+			if ( esc )
+			{
+				esc = false;
+			}
+			else if ( ch == '\\' )
+			{
+				esc = true;
+				continue;
+			}
+
+			if ( first )
+				first = false, ret.data = ch;
+
+			text += ch;
+		}
+
+		if ( p < len )
+			++p;
+
+		ret.type = ARG_TEXT;
+		ret.text = stringpool.intern( text );
+		log.debug( "Text: [%s]", text.data() );
+	}
+
+	// The source text of a value that isn't a symbol is the expression, left
+	// to 0 here and interned when the value leaves the parser.
 	Arg parsevalue()
 	{
-		Arg ret = { ARG_IMM, 0xFFFF, expr, "" };
+		Arg ret = { ARG_IMM, 0xFFFF, 0, 0, 0 };
 		skipblk();
 		if ( p < len )
 		{
@@ -117,47 +157,21 @@ public:
 			}
 			else if ( c == '"' || c == '\'' )
 			{
-				++p;
-				bool esc = false, first = true;
-
-				while ( p < len && ( esc || expr[p] != c ) )
-				{
-					char ch = expr[p++];
-
-					if ( esc )
-					{
-						esc = false;
-					}
-					else if ( ch == '\\' )
-					{
-						esc = true;
-						continue;
-					}
-
-					if ( first )
-						first = false, ret.data = ch;
-
-					ret.text += ch;
-				}
-
-				if ( p < len )
-					++p;
-
-				ret.type = ARG_TEXT;
-				log.debug( "Text: [%s]", ret.text.data() );
+				parsetext( ret );
 			}
 			else if ( c == '_' || c == '$' || isalpha( c ) )
 			{
-				string name = parsename();
+				StringView name = parsename();
 				if ( name == "$" )
 					ret.data = pc;
-				else
+				else if ( symbols.definesRegisters() || !Registers::parse( name, ret ) )
 				{
+					// Rnn and Pnn need no lookup unless a symbol redefines one
 					Arg sym = symbols.getSymbol( name );
 
 					if ( sym.type != ARG_UNDEF )
 						ret = sym;
-					else
+					else if ( !Registers::parse( name, ret ) )
 					{
 						FunctionPtr_t itFunc = functions.find( name );
 						if ( itFunc != functions.end() )
@@ -180,6 +194,8 @@ public:
 									++p;
 								}
 								Arg arg = parsevalue();
+								if ( !arg.str )
+									arg.str = stringpool.intern( expr );
 								symbols.addLocalSymbol( func.params_[i], arg );
 								log.debug( "%s = (%s)%04X", func.params_[i].data(), ArgTypes::get(arg.type), arg.data );
 							}
@@ -193,15 +209,19 @@ public:
 
 							Parser parser( func.expr_ );
 							ret = parser.parse();
+							if ( !ret.str )
+								ret.str = stringpool.intern( func.expr_ );
 							log.debug( "%s = (%s)%04X", func.expr_.data(), ArgTypes::get(ret.type), ret.data );
 							if ( !parser.eof() )
-								log.error( "Error evaluating function %s: %s", name.data(), func.expr_.data() );
+								log.error( "Error evaluating function %s: %s", name.str().data(), func.expr_.data() );
 
 							symbols.endSymbols();
 
 						}
+						else if ( fixups.isEnabled() )
+							ret.undef = fixups.undefined( name.str() );
 						else
-							log.error( "Symbol not found: [%s]", name.data() );
+							log.error( "Symbol not found: [%s]", name.str().data() );
 					}
 				}
 			}
@@ -224,9 +244,11 @@ public:
 			{
 				++p;
 				Arg rhs = parsevalue();
+				if ( !ret.undef )
+					ret.undef = rhs.undef;
 				if ( ret.type == ARG_IMM && rhs.type == ARG_IMM )
 					ret.data += rhs.data;
-				else if ( ret.type == ARG_TEXT && rhs.type == ARG_IMM && ret.text.size() == 1 )
+				else if ( ret.type == ARG_TEXT && rhs.type == ARG_IMM && ret.gettext().size() == 1 )
 				{
 					ret.type = rhs.type;
 					ret.data += rhs.data;
@@ -239,9 +261,11 @@ public:
 			{
 				++p;
 				Arg rhs = parsevalue();
+				if ( !ret.undef )
+					ret.undef = rhs.undef;
 				if ( ret.type == ARG_IMM && rhs.type == ARG_IMM )
 					ret.data -= rhs.data;
-				else if ( ret.type == ARG_TEXT && rhs.type == ARG_IMM && ret.text.size() == 1 )
+				else if ( ret.type == ARG_TEXT && rhs.type == ARG_IMM && ret.gettext().size() == 1 )
 				{
 					ret.type = rhs.type;
 					ret.data -= rhs.data;
@@ -254,9 +278,11 @@ public:
 			{
 				++p;
 				Arg rhs = parsevalue();
+				if ( !ret.undef )
+					ret.undef = rhs.undef;
 				if ( ret.type == ARG_IMM && rhs.type == ARG_IMM )
 					ret.data *= rhs.data;
-				else if ( ret.type == ARG_TEXT && rhs.type == ARG_IMM && ret.text.size() == 1 )
+				else if ( ret.type == ARG_TEXT && rhs.type == ARG_IMM && ret.gettext().size() == 1 )
 				{
 					ret.type = rhs.type;
 					ret.data *= rhs.data;
@@ -269,9 +295,11 @@ public:
 			{
 				++p;
 				Arg rhs = parsevalue();
+				if ( !ret.undef )
+					ret.undef = rhs.undef;
 				if ( ret.type == ARG_IMM && rhs.type == ARG_IMM )
 					ret.data /= rhs.data;
-				else if ( ret.type == ARG_TEXT && rhs.type == ARG_IMM && ret.text.size() == 1 )
+				else if ( ret.type == ARG_TEXT && rhs.type == ARG_IMM && ret.gettext().size() == 1 )
 				{
 					ret.type = rhs.type;
 					ret.data /= rhs.data;
@@ -284,9 +312,11 @@ public:
 			{
 				++p;
 				Arg rhs = parsevalue();
+				if ( !ret.undef )
+					ret.undef = rhs.undef;
 				if ( ret.type == ARG_IMM && rhs.type == ARG_IMM )
 					ret.data %= rhs.data;
-				else if ( ret.type == ARG_TEXT && rhs.type == ARG_IMM && ret.text.size() == 1 )
+				else if ( ret.type == ARG_TEXT && rhs.type == ARG_IMM && ret.gettext().size() == 1 )
 				{
 					ret.type = rhs.type;
 					ret.data %= rhs.data;
@@ -299,9 +329,11 @@ public:
 			{
 				++p;
 				Arg rhs = parsevalue();
+				if ( !ret.undef )
+					ret.undef = rhs.undef;
 				if ( ret.type == ARG_IMM && rhs.type == ARG_IMM )
 					ret.data &= rhs.data;
-				else if ( ret.type == ARG_TEXT && rhs.type == ARG_IMM && ret.text.size() == 1 )
+				else if ( ret.type == ARG_TEXT && rhs.type == ARG_IMM && ret.gettext().size() == 1 )
 				{
 					ret.type = rhs.type;
 					ret.data &= rhs.data;
@@ -314,9 +346,11 @@ public:
 			{
 				++p;
 				Arg rhs = parsevalue();
+				if ( !ret.undef )
+					ret.undef = rhs.undef;
 				if ( ret.type == ARG_IMM && rhs.type == ARG_IMM )
 					ret.data |= rhs.data;
-				else if ( ret.type == ARG_TEXT && rhs.type == ARG_IMM && ret.text.size() == 1 )
+				else if ( ret.type == ARG_TEXT && rhs.type == ARG_IMM && ret.gettext().size() == 1 )
 				{
 					ret.type = rhs.type;
 					ret.data |= rhs.data;
@@ -329,9 +363,11 @@ public:
 			{
 				++p;
 				Arg rhs = parsevalue();
+				if ( !ret.undef )
+					ret.undef = rhs.undef;
 				if ( ret.type == ARG_IMM && rhs.type == ARG_IMM )
 					ret.data ^= rhs.data;
-				else if ( ret.type == ARG_TEXT && rhs.type == ARG_IMM && ret.text.size() == 1 )
+				else if ( ret.type == ARG_TEXT && rhs.type == ARG_IMM && ret.gettext().size() == 1 )
 				{
 					ret.type = rhs.type;
 					ret.data ^= rhs.data;
@@ -344,9 +380,11 @@ public:
 			{
 				p += 2;
 				Arg rhs = parsevalue();
+				if ( !ret.undef )
+					ret.undef = rhs.undef;
 				if ( ret.type == ARG_IMM && rhs.type == ARG_IMM )
 					ret.data <<= rhs.data;
-				else if ( ret.type == ARG_TEXT && rhs.type == ARG_IMM && ret.text.size() == 1 )
+				else if ( ret.type == ARG_TEXT && rhs.type == ARG_IMM && ret.gettext().size() == 1 )
 				{
 					ret.type = rhs.type;
 					ret.data <<= rhs.data;
@@ -359,9 +397,11 @@ public:
 			{
 				p += 2;
 				Arg rhs = parsevalue();
+				if ( !ret.undef )
+					ret.undef = rhs.undef;
 				if ( ret.type == ARG_IMM && rhs.type == ARG_IMM )
 					ret.data >>= rhs.data;
-				else if ( ret.type == ARG_TEXT && rhs.type == ARG_IMM && ret.text.size() == 1 )
+				else if ( ret.type == ARG_TEXT && rhs.type == ARG_IMM && ret.gettext().size() == 1 )
 				{
 					ret.type = rhs.type;
 					ret.data >>= rhs.data;
@@ -374,9 +414,11 @@ public:
 			{
 				p += 3;
 				Arg rhs = parsevalue();
+				if ( !ret.undef )
+					ret.undef = rhs.undef;
 				if ( ret.type == ARG_IMM && rhs.type == ARG_IMM )
 				{
-					ret.text = string( ret.data, rhs.data );
+					ret.text = stringpool.intern( string( ret.data, rhs.data ) );
 					ret.type = ARG_DUP;
 				}
 				else
@@ -389,7 +431,7 @@ public:
 			}
 			else
 			{
-				log.error( "[%c]: unsupported operator in [%s]", c, expr.data() ) ;
+				log.error( "[%c]: unsupported operator in [%s]", c, expr.str().data() ) ;
 				break;
 			}
 
@@ -403,18 +445,177 @@ public:
 		return p >= len;
 	}
 
-	static Arg parse( const string &arg )
+	// Compiles the expression to postfix code, none if only parse() can
+	// evaluate it: DUP, syntax error.
+	Expression compile()
 	{
-		Arg ret = { ARG_NONE, 0xFFFF, arg, "" };
+		Expression ret;
+		size_t depth = 0;
+		if ( !compileparse( ret, depth ) || !eof() || ret.stack_ > Expression::STACK )
+			ret.code_.clear();
+		ret.text_ = stringpool.intern( expr );
+		return ret;
+	}
+
+	bool compileparse( Expression &ret, size_t &depth )
+	{
+		if ( !compilevalue( ret, depth ) )
+			return false;
+		skipblk();
+		while ( p < len )
+		{
+			ExprCode code = { EXPR_VALUE, 0, { ARG_IMM, 0, 0, 0, 0 } };
+			switch ( expr[p] )
+			{
+			case '+':	code.op = EXPR_ADD;	break;
+			case '-':	code.op = EXPR_SUB;	break;
+			case '*':	code.op = EXPR_MUL;	break;
+			case '/':	code.op = EXPR_DIV;	break;
+			case '%':	code.op = EXPR_MOD;	break;
+			case '&':	code.op = EXPR_AND;	break;
+			case '|':	code.op = EXPR_OR;	break;
+			case '^':	code.op = EXPR_XOR;	break;
+			}
+
+			if ( code.op != EXPR_VALUE )
+				++p;
+			else if ( expr.substr( p, 2 ) == "<<" )
+				code.op = EXPR_SHL, p += 2;
+			else if ( expr.substr( p, 2 ) == ">>" )
+				code.op = EXPR_SHR, p += 2;
+			else if ( expr[p] == ')' )
+				break;
+			else
+				return false;
+
+			if ( !compilevalue( ret, depth ) )
+				return false;
+			ret.code_.push_back( code );
+			--depth;
+
+			skipblk();
+		}
+		return true;
+	}
+
+	bool compilevalue( Expression &ret, size_t &depth )
+	{
+		ExprCode code = { EXPR_VALUE, 0, { ARG_IMM, 0xFFFF, 0, 0, 0 } };
+		skipblk();
+		if ( p < len )
+		{
+			char c = expr[p];
+			if ( c == '>' )
+			{
+				++p;
+				code.arg.data = parsenum( 16 );
+			}
+			else if ( isdigit( c ) )
+			{
+				code.arg.data = parsenum( 0 );
+			}
+			else if ( c == '(' )
+			{
+				++p;
+				if ( !compileparse( ret, depth ) )
+					return false;
+				skipblk();
+				if ( p < len && expr[p] == ')' )
+					++p;
+				return true;
+			}
+			else if ( c == '"' || c == '\'' )
+			{
+				parsetext( code.arg );
+			}
+			else if ( c == '_' || c == '$' || isalpha( c ) )
+			{
+				StringView name = parsename();
+				if ( name == "$" )
+					code.op = EXPR_PC;
+				else
+				{
+					code.op = EXPR_NAME;
+					code.name = stringpool.intern( name );
+					if ( !Registers::parse( name, code.arg ) )
+						code.arg.type = ARG_UNDEF;
+					skipblk();
+					if ( p < len && expr[p] == '(' )
+						return compilecall( ret, depth, code );
+				}
+			}
+			else
+			{
+				return false;
+			}
+		}
+		ret.code_.push_back( code );
+		if ( ++depth > ret.stack_ )
+			ret.stack_ = depth;
+		return true;
+	}
+
+	// name(arg,...): each argument is a value, as parsevalue() reads them.
+	bool compilecall( Expression &ret, size_t &depth, ExprCode code )
+	{
+		++p;
+		size_t args = 0;
+		size_t start = ret.code_.size();
+		code.op = EXPR_ARGS;
+		ret.code_.push_back( code );
+
+		skipblk();
+		while ( p < len && expr[p] != ')' )
+		{
+			if ( args > 0 )
+			{
+				if ( expr[p] != ',' )
+					return false;
+				++p;
+			}
+			if ( !compilevalue( ret, depth ) )
+				return false;
+			code.op = EXPR_ARG;
+			ret.code_.push_back( code );
+			++args;
+			skipblk();
+		}
+
+		if ( p >= len )
+			return false;
+		++p;
+
+		ret.code_[start].arg.data = word( args );
+		code.op = EXPR_CALL;
+		ret.code_.push_back( code );
+		depth -= args;
+		if ( ++depth > ret.stack_ )
+			ret.stack_ = depth;
+		return true;
+	}
+
+	static Arg parse( const StringView &arg )
+	{
+		Arg ret = { ARG_NONE, 0xFFFF, 0, 0, 0 };
 
 		size_t size = arg.size();
 
 		if ( size )
 		{
-			Parser parser( arg );
-			ret = parser.parse();
-			if ( !parser.eof() )
-				log.error( "Parse error: %s", arg.data() );
+			strid_t id = stringpool.intern( arg );
+			const Expression *compiled = expressions.find( id );
+			if ( !compiled )
+				compiled = expressions.add( id, Parser( arg ).compile() );
+
+			if ( !compiled->evaluate( ret ) )
+			{
+				Parser parser( arg );
+				ret = parser.parse();
+				if ( !parser.eof() )
+					log.error( "Parse error: %s", arg.str().data() );
+			}
+			if ( !ret.str )
+				ret.str = id;
 		}
 		else
 		{
@@ -423,12 +624,20 @@ public:
 		return ret;
 	}
 
-	static Arg getarg( const string &arg )
+	static Arg getarg( const StringView &arg )
+	{
+		return getarg( arg, stringpool.intern( arg ) );
+	}
+
+	// id: the operand already interned.
+	static Arg getarg( const StringView &arg, strid_t id )
 	{
 		Arg ret;
 		ret.type = ARG_NONE;
 		ret.data = 0;
-		ret.str  = arg;
+		ret.str  = id;
+		ret.text = 0;
+		ret.undef = 0;
 
 		size_t size = arg.size();
 
@@ -449,41 +658,53 @@ public:
 			if ( size > 3 && arg.find( "(B)" ) == arg.size() - 3 )
 			{
 				ret.type = ARG_EFFEC;
-				ret.data = parse( arg.substr( 1, arg.size() - 4 ) ).data;
+				Arg val = parse( arg.substr( 1, arg.size() - 4 ) );
+				ret.data = val.data;
+				ret.undef = val.undef;
 			}
 			else
 			{
 				ret.type = ARG_IMM;
-				ret.data = parse( arg.substr( 1 ) ).data;
+				Arg val = parse( arg.substr( 1 ) );
+				ret.data = val.data;
+				ret.undef = val.undef;
 			}
 		}
 		else if ( size > 2 && arg[0] == '*' )
 		{
 			ret.type = ARG_INDIR;
-			ret.data = parse( arg.substr( 1 ) ).data;
+			Arg val = parse( arg.substr( 1 ) );
+			ret.data = val.data;
+			ret.undef = val.undef;
 		}
 		else if ( arg[0] == '@' )
 		{
 			if ( arg.find( "(B)" ) == arg.size() - 3 )
 			{
 				ret.type = ARG_INDEX;
-				ret.data = parse( arg.substr( 1, arg.size() - 4 ) ).data;
+				Arg val = parse( arg.substr( 1, arg.size() - 4 ) );
+				ret.data = val.data;
+				ret.undef = val.undef;
 			}
 			else
 			{
 				ret.type = ARG_DIR;
-				ret.data = parse( arg.substr( 1 ) ).data;
+				Arg val = parse( arg.substr( 1 ) );
+				ret.data = val.data;
+				ret.undef = val.undef;
 			}
 		}
 		else
 		{
 			ret = parse( arg );
+			if ( ret.undef )
+				ret.str = stringpool.intern( arg );	// the whole operand, to evaluate it again
 		}
 		return ret;
 	}
 
 private:
-	const string &expr;
+	const StringView expr;
 	const size_t len;
 	size_t p;
 };
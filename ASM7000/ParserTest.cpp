@@ -3,9 +3,12 @@
 #include <iostream>
 
 Log log;
+StringPool stringpool;
 Symbols symbols;
+Expressions expressions;
 word pc;
 FunctionSeq_t functions;
+Fixups fixups;
 
 int parsenumTest( const string &arg, int radix, int expected )
 {
@@ -66,9 +69,9 @@ int main()
 	ret += parseTest( "3-(2+1)", 0 );
 	ret += parseTest( "3 - ( 2 + 1 )", 0 );
 
-	Arg one   = { ARG_IMM, 1, "", "" };
-	Arg two   = { ARG_IMM, 2, "", "" };
-	Arg three = { ARG_IMM, 3, "", "" };
+	Arg one   = { ARG_IMM, 1, 0, 0, 0 };
+	Arg two   = { ARG_IMM, 2, 0, 0, 0 };
+	Arg three = { ARG_IMM, 3, 0, 0, 0 };
 	symbols.addSymbol( "ONE",   one );
 	symbols.addSymbol( "TWO",   two );
 	symbols.addSymbol( "THREE", three );
@@ -95,6 +98,43 @@ int main()
 	ret += parseTest( "255/15", 17 );
 	ret += parseTest( "256%15", 1 );
 
+	Arg text = Parser::getarg( "'AB'" );
+	ret += ( text.type != ARG_TEXT || text.gettext() != "AB" || text.getstr() != "'AB'" || text.data != 'A' );
+	Arg dup = Parser::getarg( "3 DUP 7" );
+	ret += ( dup.type != ARG_DUP || dup.gettext() != string( 3, 7 ) );
+	Arg byname = Parser::getarg( "THREE" );
+	ret += ( byname.data != 3 || byname.getstr() != "THREE" );
+	Arg sum = Parser::getarg( "1+2" );
+	ret += ( sum.data != 3 || sum.getstr() != "1+2" );
+
+	// registers and ports are built in, symbols only hold aliases
+	Arg reg = Parser::getarg( "R255" );
+	ret += ( reg.type != ARG_REG || reg.data != 255 || reg.getstr() != "R255" );
+	Arg port = Parser::getarg( "P10" );
+	ret += ( port.type != ARG_PORT || port.data != 0x10A || port.getstr() != "P10" );
+	symbols.addSymbol( "FLAGS", reg );
+	Arg alias = Parser::getarg( "FLAGS" );
+	ret += ( alias.type != ARG_REG || alias.data != 255 );
+	symbols.addSymbol( "R5", three );
+	Arg redefined = Parser::getarg( "R5" );
+	ret += ( redefined.type != ARG_IMM || redefined.data != 3 );
+	reg = Parser::getarg( "R6" );
+	ret += ( reg.type != ARG_REG || reg.data != 6 );
+
+	// a span of a larger text: the parser doesn't read past it
+	const string operands = "THREE<<2,7";
+	Arg span = Parser::getarg( StringView( operands.data(), 8 ) );
+	ret += ( span.data != 12 || span.getstr() != "THREE<<2" );
+
+	fixups.setEnabled( true );
+	Arg fwd = Parser::getarg( "@THREE+FWD" );
+	if ( !fwd.undef || fixups.undefinedName( fwd.undef ) != "FWD" || fwd.getstr() != "@THREE+FWD" )
+	{
+		cerr << "Forward reference test failed: [" << fwd.getstr() << "]" << endl;
+		++ret;
+	}
+	fixups.setEnabled( false );
+
 	symbols.endSymbols();
 
 	return ret;
@@ -0,0 +1,134 @@
+#pragma once
+
+#include "SourceCache.h"
+#include "IncludePath.h"
+
+#include <string>
+#include <deque>
+#include <set>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+using namespace std;
+
+/////// PREFETCHER ////////////////////////////////////////////////////////////
+
+// Loads include files in the source cache on a background thread. Each
+// loaded file is scanned for COPY/INCLUDE/GET directives and the files they
+// name are queued in turn, so they are in memory when the assembler reaches
+// them.
+class Prefetcher
+{
+public:
+	Prefetcher( SourceCache &cache, IncludePath &path )
+	: cache_( cache ), path_( path ), stop_( false )
+	{
+	}
+
+	~Prefetcher()
+	{
+		if ( thread_.joinable() )
+		{
+			{
+				lock_guard< mutex > lock( mutex_ );
+				stop_ = true;
+			}
+			queued_.notify_one();
+			thread_.join();
+		}
+	}
+
+	void prefetch( const string &name )
+	{
+		lock_guard< mutex > lock( mutex_ );
+		if ( !requested_.insert( name ).second )
+			return;
+		queue_.push_back( name );
+		if ( !thread_.joinable() )
+			thread_ = thread( &Prefetcher::run, this );
+		queued_.notify_one();
+	}
+
+	// Returns the file named by an include directive in the line, if any.
+	static StringView getinclude( const StringView &line )
+	{
+		const char *p = line.begin();
+		const char *end = line.end();
+
+		if ( p < end && *p == ';' )
+			return StringView();
+		while ( p < end && !issep( *p ) )	// label
+			++p;
+		while ( p < end && issep( *p ) )
+			++p;
+		const char *op = p;
+		while ( p < end && !issep( *p ) )
+			++p;
+		StringView opview( op, p - op );
+		if ( !isop( opview, "COPY" ) && !isop( opview, "INCLUDE" ) && !isop( opview, "GET" ) )
+			return StringView();
+		while ( p < end && issep( *p ) )
+			++p;
+		const char *name = p;
+		while ( p < end && !issep( *p ) && *p != ';' )
+			++p;
+		return StringView( name, p - name );
+	}
+
+private:
+	void run()
+	{
+		unique_lock< mutex > lock( mutex_ );
+		while ( true )
+		{
+			while ( !stop_ && queue_.empty() )
+				queued_.wait( lock );
+			if ( stop_ )
+				break;
+			string name = queue_.front();
+			queue_.pop_front();
+			lock.unlock();
+
+			const FileData *data = cache_.get( name );
+			if ( data )
+			{
+				for ( size_t i=0; i<data->lines(); ++i )
+				{
+					StringView include = getinclude( data->line( i ) );
+					if ( !include.empty() )
+						prefetch( path_.find( include.str() ) );
+				}
+			}
+
+			lock.lock();
+		}
+	}
+
+	static bool issep( char c )
+	{
+		return c == '\t' || c == ' ' || c == ':';
+	}
+
+	static bool isop( const StringView &op, const char *name )
+	{
+		size_t i = 0;
+		for ( ; i<op.size() && name[i]; ++i )
+		{
+			if ( toupper( op[i] ) != name[i] )
+				return false;
+		}
+		return i == op.size() && !name[i];
+	}
+
+	SourceCache &cache_;
+	IncludePath &path_;
+	set< string > requested_;
+	deque< string > queue_;
+	thread thread_;
+	mutex mutex_;
+	condition_variable queued_;
+	bool stop_;
+};
+
+extern Prefetcher prefetcher;
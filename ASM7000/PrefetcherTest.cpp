@@ -0,0 +1,31 @@
+#include "Prefetcher.h"
+
+#include <iostream>
+
+SourceCache sourcecache;
+IncludePath includepath;
+Prefetcher prefetcher( sourcecache, includepath );
+
+int getincludeTest( const string &line, const string &expected )
+{
+	string ret = Prefetcher::getinclude( line ).str();
+	if ( ret != expected )
+	{
+		cerr << "Test failed: expected [" << expected << "] but got [" << ret << "]" << endl;
+		return 1;
+	}
+	return 0;
+}
+
+int main()
+{
+	prefetcher.prefetch( "PrefetcherTest.cpp" );
+
+	return	getincludeTest( "\tINCLUDE\tREGS.EQU\t; registers", "REGS.EQU" )
+		+	getincludeTest( "LBL:\tcopy ports.equ", "ports.equ" )
+		+	getincludeTest( "\tGET\tA.ASM;comment", "A.ASM" )
+		+	getincludeTest( "; INCLUDE\tREGS.EQU", "" )
+		+	getincludeTest( "\tINCLUDES\tREGS.EQU", "" )
+		+	getincludeTest( "\tMOV\tR1,A", "" )
+		+	( sourcecache.get( "PrefetcherTest.cpp" ) == 0 );
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "ArgType.h"
+#include "StringView.h"
+
+/////// REGISTERS /////////////////////////////////////////////////////////////
+
+// Built-in names of the registers R0-R255 and of the ports P0-P255, in upper
+// case and decimal without leading zero. They are recognized by the parser
+// rather than stored as symbols; symbols only hold user aliases such as
+// FLAGS EQU R10.
+class Registers
+{
+public:
+	static bool isname( const StringView &name )
+	{
+		Arg arg;
+		return parse( name, arg );
+	}
+
+	// Sets the type and value of a register or port operand.
+	static bool parse( const StringView &name, Arg &arg )
+	{
+		size_t size = name.size();
+		if ( size < 2 || size > 4 || ( name[0] != 'R' && name[0] != 'P' ) )
+			return false;
+		if ( name[1] == '0' && size > 2 )
+			return false;
+		unsigned n = 0;
+		for ( size_t i=1; i<size; ++i )
+		{
+			char c = name[i];
+			if ( c < '0' || c > '9' )
+				return false;
+			n = 10 * n + ( c - '0' );
+		}
+		if ( n > 0xFF )
+			return false;
+		if ( name[0] == 'R' )
+		{
+			arg.type = ARG_REG;
+			arg.data = word( n );
+		}
+		else
+		{
+			arg.type = ARG_PORT;
+			arg.data = word( n + 0x100 );
+		}
+		return true;
+	}
+};
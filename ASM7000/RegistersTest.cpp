@@ -0,0 +1,43 @@
+#include "Registers.h"
+
+#include <iostream>
+
+StringPool stringpool;
+
+int registerTest( const string &name, ArgType type, word data )
+{
+	Arg arg = { ARG_NONE, 0, 0, 0, 0 };
+	bool found = Registers::parse( name, arg );
+
+	if ( found != ( type != ARG_NONE ) || arg.type != type || ( found && arg.data != data ) )
+	{
+		cerr << "registerTest failed [" << name << "]: got [" << ArgTypes::get(arg.type) << "] " << arg.data << endl;
+		return 1;
+	}
+
+	return 0;
+}
+
+int main()
+{
+	int ret = 0;
+	ret += registerTest( "R0", ARG_REG, 0 );
+	ret += registerTest( "R10", ARG_REG, 10 );
+	ret += registerTest( "R255", ARG_REG, 255 );
+	ret += registerTest( "P0", ARG_PORT, 0x100 );
+	ret += registerTest( "P255", ARG_PORT, 0x1FF );
+
+	ret += registerTest( "R256", ARG_NONE, 0 );
+	ret += registerTest( "R05", ARG_NONE, 0 );
+	ret += registerTest( "R00", ARG_NONE, 0 );
+	ret += registerTest( "R", ARG_NONE, 0 );
+	ret += registerTest( "r5", ARG_NONE, 0 );
+	ret += registerTest( "R5H", ARG_NONE, 0 );
+	ret += registerTest( "A5", ARG_NONE, 0 );
+	ret += registerTest( "R1000", ARG_NONE, 0 );
+
+	ret += !Registers::isname( "P23" );
+	ret += Registers::isname( "PC" );
+
+	return ret;
+}
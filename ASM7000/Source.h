@@ -19,6 +19,18 @@ public:
 	{
 	}
 
+	// Reads a file already in the source cache.
+	Source( const string &name, const FileData *data )
+	: source_( new FileSource( name, data ) )
+	{
+	}
+
+	// Reads a stream (standard input), spooled in memory.
+	Source( const string &name, istream &in )
+	: source_( new FileSource( name, sourcecache.spool( name, in ) ) )
+	{
+	}
+
 #if MACRO
 	Source( const string &name, Macro &macro )
 	: source_( new MacroSource( name, macro ) )
@@ -59,6 +71,11 @@ public:
 		return source_->getline();
 	}
 
+	virtual StringView getlineview()
+	{
+		return source_->getlineview();
+	}
+
 	virtual bool operator!()
 	{
 		return !*source_;
@@ -0,0 +1,225 @@
+#pragma once
+
+#include "MappedFile.h"
+#include "StringView.h"
+
+#include <string>
+#include <vector>
+#include <map>
+#include <istream>
+#include <iterator>
+#include <mutex>
+#include <condition_variable>
+#include <cstdlib>
+#include <climits>
+#include <sys/stat.h>
+
+using namespace std;
+
+/////// SOURCE CACHE //////////////////////////////////////////////////////////
+
+// Contents of a source file and its line index.
+class FileData
+{
+public:
+	// Maps the file.
+	FileData( const string &path )
+	: path_( path ), file_( new MappedFile( path ) ), hashed_( false )
+	{
+		fail_ = !*file_;
+		index( file_->data(), file_->size() );
+	}
+
+	// Spools a stream in memory.
+	FileData( const string &name, istream &in )
+	: path_( name ), file_( 0 ), hashed_( false )
+	{
+		buffer_.assign( istreambuf_iterator< char >( in ), istreambuf_iterator< char >() );
+		fail_ = in.bad();
+		index( buffer_.data(), buffer_.size() );
+	}
+
+	~FileData()
+	{
+		delete file_;
+	}
+
+	bool operator!() const
+	{
+		return fail_;
+	}
+
+	const string &path() const
+	{
+		return path_;
+	}
+
+	size_t lines() const
+	{
+		return lines_.size() - 1;
+	}
+
+	StringView contents() const
+	{
+		return StringView( data_, lines_.back() );
+	}
+
+	// FNV-1a hash of the contents, computed on first use.
+	unsigned long long hash() const
+	{
+		if ( !hashed_ )
+		{
+			hash_ = 14695981039346656037ULL;
+			const char *end = data_ + lines_.back();
+			for ( const char *p = data_; p < end; ++p )
+			{
+				hash_ ^= (unsigned char)*p;
+				hash_ *= 1099511628211ULL;
+			}
+			hashed_ = true;
+		}
+		return hash_;
+	}
+
+	// Line n (0-based), without its CR/LF terminator.
+	StringView line( size_t n ) const
+	{
+		const char *p = data_ + lines_[n];
+		size_t len = lines_[n+1] - lines_[n];
+		if ( len && p[len-1] == '\n' )
+			--len;
+		if ( len && p[len-1] == '\r' )
+			--len;
+		return StringView( p, len );
+	}
+
+private:
+	FileData( const FileData & );
+	FileData &operator=( const FileData & );
+
+	void index( const char *data, size_t size )
+	{
+		data_ = data;
+		const char *p = data;
+		const char *end = data + size;
+		while ( p < end )
+		{
+			lines_.push_back( p - data );
+			p = (const char*)memchr( p, '\n', end - p );
+			if ( !p )
+				break;
+			++p;
+		}
+		lines_.push_back( size );
+	}
+
+	string path_;
+	MappedFile *file_;
+	string buffer_;
+	const char *data_;
+	bool fail_;
+	vector< size_t > lines_;
+	mutable bool hashed_;
+	mutable unsigned long long hash_;
+};
+
+
+// Process-wide cache of source files, keyed by canonical path and checked
+// against the file modification time and size, so that a file is read once
+// per run however many times or passes it is included. Files may be loaded
+// by the include prefetcher thread: a lookup of a file being loaded waits
+// for it.
+class SourceCache
+{
+public:
+	~SourceCache()
+	{
+		for ( entryptr_t it = entries_.begin(); it != entries_.end(); ++it )
+			delete it->second.data;
+		for ( size_t i=0; i<detached_.size(); ++i )
+			delete detached_[i];
+	}
+
+	// Returns the contents of a stream (standard input), spooled in memory
+	// so that it can be read again by pass 2.
+	const FileData *spool( const string &name, istream &in )
+	{
+		FileData *data = new FileData( name, in );
+		lock_guard< mutex > lock( mutex_ );
+		detached_.push_back( data );
+		return !*data ? 0 : data;
+	}
+
+	// Returns the contents of the file, or 0 if it can't be read.
+	const FileData *get( const string &name )
+	{
+		struct stat st;
+		if ( stat( name.data(), &st ) )
+			return 0;
+
+		string path = canonical( name );
+
+		unique_lock< mutex > lock( mutex_ );
+		Entry &entry = entries_[path];
+
+		while ( entry.loading )
+			loaded_.wait( lock );
+
+		if ( entry.data && ( entry.mtime != st.st_mtime || entry.size != st.st_size ) )
+		{
+			// changed on disk: sources still reading the old contents keep it
+			detached_.push_back( entry.data );
+			entry.data = 0;
+		}
+
+		if ( !entry.data )
+		{
+			entry.loading = true;
+			lock.unlock();
+			FileData *data = new FileData( path );
+			lock.lock();
+			entry.loading = false;
+			entry.data = data;
+			entry.mtime = st.st_mtime;
+			entry.size = st.st_size;
+			loaded_.notify_all();
+		}
+
+		return !*entry.data ? 0 : entry.data;
+	}
+
+	static string canonical( const string &name )
+	{
+#ifdef _WIN32
+		char buf[_MAX_PATH];
+		if ( _fullpath( buf, name.data(), sizeof buf ) )
+			return buf;
+#else
+		char buf[PATH_MAX];
+		if ( realpath( name.data(), buf ) )
+			return buf;
+#endif
+		return name;
+	}
+
+private:
+	struct Entry
+	{
+		Entry() : data( 0 ), loading( false ), mtime( 0 ), size( 0 ) {}
+
+		FileData *data;
+		bool loading;
+		time_t mtime;
+		long long size;
+	};
+
+	typedef map< string, Entry > entries_t;
+	typedef entries_t::iterator entryptr_t;
+
+	entries_t entries_;
+	vector< FileData* > detached_;
+	mutex mutex_;
+	condition_variable loaded_;
+};
+
+extern SourceCache sourcecache;
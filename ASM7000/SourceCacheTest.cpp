@@ -0,0 +1,20 @@
+#include "SourceCache.h"
+
+#include <sstream>
+
+SourceCache sourcecache;
+
+int main()
+{
+	const FileData *data = sourcecache.get( "SourceCacheTest.cpp" );
+	if ( !data || data->line( 0 ) != "#include \"SourceCache.h\"" )
+		return 1;
+
+	istringstream in( "\tNOP\r\n\tEND" );
+	const FileData *spooled = sourcecache.spool( "stdin", in );
+	if ( !spooled || spooled->lines() != 2 || spooled->line( 0 ) != "\tNOP" || spooled->line( 1 ) != "\tEND" )
+		return 1;
+
+	return ( sourcecache.get( "./SourceCacheTest.cpp" ) != data )
+		+	( sourcecache.get( "SourceCacheTest.none" ) != 0 );
+}
@@ -1,5 +1,7 @@
 #pragma once
 
+#include "StringView.h"
+
 #include <string>
 
 using namespace std;
@@ -15,6 +17,8 @@ public:
 
 	virtual string getline() = 0;
 
+	virtual StringView getlineview() = 0;
+
 	virtual bool operator!() = 0;
 
 	operator bool()
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "StringView.h"
+
+#include <string>
+#include <deque>
+#include <unordered_map>
+
+using namespace std;
+
+/////// STRING POOL ///////////////////////////////////////////////////////////
+
+typedef unsigned strid_t;	// handle of an interned string, 0 for ""
+
+// Interned strings: each distinct string is stored once, for the run, and
+// referred to by a handle. Equal handles mean equal strings.
+class StringPool
+{
+public:
+	StringPool()
+	{
+		strings_.push_back( string() );
+	}
+
+	strid_t intern( const StringView &str )
+	{
+		if ( str.empty() )
+			return 0;
+		index_t::const_iterator it = index_.find( str );
+		if ( it != index_.end() )
+			return it->second;
+		strid_t id = strid_t( strings_.size() );
+		strings_.push_back( string( str.data(), str.size() ) );
+		index_[StringView( strings_.back() )] = id;	// the deque doesn't move its elements
+		return id;
+	}
+
+	// Handle of a string already interned, 0 if none.
+	strid_t find( const StringView &str ) const
+	{
+		index_t::const_iterator it = index_.find( str );
+		return it != index_.end() ? it->second : 0;
+	}
+
+	const string &get( strid_t id ) const
+	{
+		return strings_[id];
+	}
+
+	size_t size() const
+	{
+		return strings_.size();
+	}
+
+private:
+	// FNV-1a
+	struct Hash
+	{
+		size_t operator()( const StringView &str ) const
+		{
+			unsigned hash = 2166136261u;
+			for ( size_t i=0; i<str.size(); ++i )
+				hash = ( hash ^ (unsigned char)str[i] ) * 16777619u;
+			return hash;
+		}
+	};
+
+	typedef unordered_map< StringView, strid_t, Hash > index_t;
+
+	deque< string > strings_;
+	index_t index_;
+};
+
+extern StringPool stringpool;
@@ -0,0 +1,25 @@
+#include "StringPool.h"
+
+StringPool stringpool;
+
+int main()
+{
+	int ret = 0;
+
+	ret += ( stringpool.intern( "" ) != 0 );
+	ret += ( stringpool.get( 0 ) != "" );
+
+	strid_t r5 = stringpool.intern( "R5" );
+	strid_t loop = stringpool.intern( string( "LOOP" ) );
+	ret += ( r5 == 0 || loop == 0 || r5 == loop );
+	ret += ( stringpool.intern( StringView( "R5,A", 2 ) ) != r5 );
+	ret += ( stringpool.get( loop ) != "LOOP" );
+
+	// the handles stay valid as the pool grows
+	for ( int i=0; i<1000; ++i )
+		stringpool.intern( string( i % 50 + 1, char( 'A' + i % 26 ) ) );
+	ret += ( stringpool.get( r5 ) != "R5" );
+	ret += ( stringpool.intern( "LOOP" ) != loop );
+
+	return ret;
+}
@@ -0,0 +1,134 @@
+#pragma once
+
+#include <string>
+#include <cstring>
+
+using namespace std;
+
+/////// STRING VIEW ///////////////////////////////////////////////////////////
+
+// Non-owning reference to a run of characters, used to hand out spans into
+// line buffers without copying them. The tree is built as C++14, so this
+// stands in for std::string_view.
+class StringView
+{
+public:
+	static const size_t npos = size_t( -1 );
+
+	StringView()
+	: data_( "" ), size_( 0 )
+	{
+	}
+
+	StringView( const char *data, size_t size )
+	: data_( data ), size_( size )
+	{
+	}
+
+	StringView( const char *str )
+	: data_( str ), size_( strlen( str ) )
+	{
+	}
+
+	StringView( const string &str )
+	: data_( str.data() ), size_( str.size() )
+	{
+	}
+
+	const char *data() const
+	{
+		return data_;
+	}
+
+	size_t size() const
+	{
+		return size_;
+	}
+
+	bool empty() const
+	{
+		return !size_;
+	}
+
+	const char *begin() const
+	{
+		return data_;
+	}
+
+	const char *end() const
+	{
+		return data_ + size_;
+	}
+
+	char operator[]( size_t i ) const
+	{
+		return data_[i];
+	}
+
+	char back() const
+	{
+		return data_[size_ - 1];
+	}
+
+	StringView substr( size_t pos, size_t n = npos ) const
+	{
+		if ( pos > size_ )
+			pos = size_;
+		if ( n > size_ - pos )
+			n = size_ - pos;
+		return StringView( data_ + pos, n );
+	}
+
+	size_t find( char c, size_t pos = 0 ) const
+	{
+		if ( pos >= size_ )
+			return npos;
+		const void *p = memchr( data_ + pos, c, size_ - pos );
+		return p ? (const char*)p - data_ : npos;
+	}
+
+	size_t find( const StringView &str, size_t pos = 0 ) const
+	{
+		if ( str.size_ > size_ )
+			return npos;
+		for ( ; pos + str.size_ <= size_; ++pos )
+		{
+			if ( !memcmp( data_ + pos, str.data_, str.size_ ) )
+				return pos;
+		}
+		return npos;
+	}
+
+	string str() const
+	{
+		return string( data_, size_ );
+	}
+
+	int compare( const StringView &other ) const
+	{
+		size_t n = size_ < other.size_ ? size_ : other.size_;
+		int ret = n ? memcmp( data_, other.data_, n ) : 0;
+		if ( ret )
+			return ret;
+		return size_ < other.size_ ? -1 : size_ > other.size_ ? 1 : 0;
+	}
+
+private:
+	const char *data_;
+	size_t size_;
+};
+
+inline bool operator==( const StringView &lhs, const StringView &rhs )
+{
+	return lhs.size() == rhs.size() && !memcmp( lhs.data(), rhs.data(), lhs.size() );
+}
+
+inline bool operator!=( const StringView &lhs, const StringView &rhs )
+{
+	return !( lhs == rhs );
+}
+
+inline bool operator<( const StringView &lhs, const StringView &rhs )
+{
+	return lhs.compare( rhs ) < 0;
+}
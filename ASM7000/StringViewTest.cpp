@@ -0,0 +1,34 @@
+#include "StringView.h"
+
+#include <iostream>
+
+int compareTest( const StringView &lhs, const StringView &rhs, int expected )
+{
+	int ret = lhs.compare( rhs );
+	ret = ret < 0 ? -1 : ret > 0 ? 1 : 0;
+	if ( ret != expected )
+	{
+		cerr << "Test failed: [" << lhs.str() << "] vs [" << rhs.str() << "]: expected [" << expected << "] but got [" << ret << "]" << endl;
+		return 1;
+	}
+	return 0;
+}
+
+int main()
+{
+	StringView sv( "LABEL\tMOV\tR1,A" );
+
+	return	compareTest( sv.substr( 0, 5 ), "LABEL", 0 )
+		+	compareTest( sv.substr( 6, 3 ), "MOV", 0 )
+		+	compareTest( sv.substr( 10 ), "R1,A", 0 )
+		+	compareTest( sv.substr( 99 ), "", 0 )
+		+	compareTest( "ABC", "ABD", -1 )
+		+	compareTest( "AB", "ABC", -1 )
+		+	compareTest( "ABC", "AB", 1 )
+		+	( sv.find( '\t' ) != 5 )
+		+	( sv.find( '\t', 6 ) != 9 )
+		+	( sv.find( ';' ) != StringView::npos )
+		+	( StringView( "@X(B)" ).find( "(B)" ) != 2 )
+		+	( StringView( "@X(B)" ).find( "(B)", 3 ) != StringView::npos )
+		+	( StringView( "(B" ).find( "(B)" ) != StringView::npos );
+}
@@ -1,7 +1,11 @@
 #pragma once
 
+#include "CharScan.h"
+#include "StringView.h"
+
 #include <string>
 #include <vector>
+#include <cstring>
 #include <time.h>
 
 using namespace std;
@@ -12,6 +16,8 @@ using namespace std;
 class Strings
 {
 public:
+	enum { MAXTOKENS = 16 };	// tokens of a line split without allocating
+
 	static char* timeStr()
 	{
 		struct tm *ptime;
@@ -27,59 +33,112 @@ public:
 		return s;
 	}
 
+	// Position of the extension of a file name, npos if none: a dot in the
+	// name itself, not in a directory.
+	static size_t extension( const string &path )
+	{
+		size_t dot = path.rfind( '.' );
+		size_t sep = path.find_last_of( "/\\:" );
+		if ( dot == string::npos || ( sep != string::npos && dot < sep ) )
+			return string::npos;
+		return dot;
+	}
 
 	// Split string to tokens using provided separator
-	static vector<string> split( string str, const string &sep )
+	static vector<string> split( const string &str, const string &sep )
 	{
+		StringView spans[MAXTOKENS];
+		size_t count = split( str, sep, spans, MAXTOKENS );
+
 		vector<string> tokens;
-		tokens.reserve( 5 );
-		const char *p0 = str.data();
-		const char *p = p0;
-		bool cmt = false;
-		char quot = 0;
+		tokens.reserve( count );
+		if ( count <= MAXTOKENS )
+		{
+			for ( size_t i=0; i<count; ++i )
+				tokens.push_back( spans[i].str() );
+		}
+		else
+		{
+			vector<StringView> more( count );
+			split( str, sep, &more[0], count );
+			for ( size_t i=0; i<count; ++i )
+				tokens.push_back( more[i].str() );
+		}
+		return tokens;
+	}
+
+	// Split string to spans of the string, in the caller's array. Returns the
+	// number of tokens: if more than max, only the first max are stored.
+	static size_t split( const StringView &str, const StringView &sep, StringView *tokens, size_t max )
+	{
+		size_t count = 0;
+
+		// token end: separator, quote or end of string
+		CharSet stops( sep.data(), sep.size() );
+		stops.add( '\'' );
+		stops.add( '"' );
+		stops.add( '\0' );
+
+		const char *p = str.begin();
+		const char *end = str.end();
 
-		while ( *p )
+		while ( p < end && *p )
 		{
-			cmt = cmt || ( !quot && *p == ';' );
-			while ( *p && ( cmt || sep.find( *p ) == string::npos ) )
-			{
-				bool esc = false;
-				do
-				{
-					if ( esc )
-					{
-						esc = false;
-					}
-					else if ( *p == '\\' )
-					{
-						esc = true;
-					}
-					else if ( quot )
-					{
-						if ( !*p || quot == *p )
-							quot = 0;
-					}
-					else if ( *p == '\'' || *p == '"' )
-					{
-						quot = *p;
-					}
-
-
-					if ( quot )
-						++p;
-				}
-				while ( *p && quot );
+			const char *p0 = p;
 
-				++p;
+			if ( *p == ';' )
+			{
+				// comment: the rest of the line
+				p = findend( p, end );
+				if ( count < max )
+					tokens[count] = StringView( p0, p - p0 );
+				++count;
+				break;
 			}
-			tokens.push_back( string( p0, p ) );
-			while ( *p && !cmt && sep.find( *p ) != string::npos )
+
+			while ( true )
 			{
-				++p;
+				p = stops.find( p, end );
+				if ( p == end || !*p || sep.find( *p ) != StringView::npos )
+					break;
+				p = skipquoted( p, end );
 			}
-			p0 = p;
+
+			if ( count < max )
+				tokens[count] = StringView( p0, p - p0 );
+			++count;
+
+			while ( p < end && *p && sep.find( *p ) != StringView::npos )
+				++p;
 		}
-		return tokens;
+		return count;
+	}
+
+	// Skips a quoted string starting at p, up to its closing quote, with
+	// backslash escapes. An unterminated string ends at the end of the line.
+	static const char *skipquoted( const char *p, const char *end )
+	{
+		const char stops[] = { *p, '\\', 0 };
+		CharSet quoted( stops, 3 );
+		++p;
+		while ( true )
+		{
+			p = quoted.find( p, end );
+			if ( p == end || !*p )
+				return p;
+			if ( *p != '\\' )
+				return p + 1;
+			if ( ++p == end || !*p )
+				return p;
+			++p;
+		}
+	}
+
+	// End of the string: first NUL or end.
+	static const char *findend( const char *p, const char *end )
+	{
+		const void *nul = memchr( p, 0, end - p );
+		return nul ? (const char*)nul : end;
 	}
 
 	// Tabulate string to given position
@@ -103,12 +162,21 @@ public:
 
 	static string touppernotquoted( const string& str )
 	{
-		string ret = str;
+		string ret;
+		touppernotquoted( str, ret );
+		return ret;
+	}
+
+	// Copies str to ret, reusing its buffer, in upper case except in quotes:
+	// folded while copied, no intermediate copy.
+	static void touppernotquoted( const StringView &str, string &ret )
+	{
+		ret.resize( str.size() );
 		bool esc = false;
 		char quot = 0;
 		for ( int i=0; i<ret.size(); ++i )
 		{
-			char c = ret[i];
+			char c = str[i];
 			if ( esc )
 				esc = false;
 			else if ( quot )
@@ -125,10 +193,19 @@ public:
 				if ( c == '"' || c == '\'' )
 					quot = c;
 				else if ( !quot )
-					ret[i] = toupper( c );
+					c = toupper( c );
 			}
+			ret[i] = c;
 		}
-		return ret;
+	}
+
+	// Copies str to ret, folded to upper case unless case-sensitive.
+	static void fold( const StringView &str, string &ret, bool casesensitive )
+	{
+		if ( casesensitive )
+			ret.assign( str.data(), str.size() );
+		else
+			touppernotquoted( str, ret );
 	}
 
 };
@@ -1,6 +1,7 @@
 #include "Strings.h"
 
 #include <iostream>
+#include <cstdlib>
 
 int touppernotquotedTest( const string &arg, const string &expected )
 {
@@ -13,10 +14,142 @@ int touppernotquotedTest( const string &arg, const string &expected )
 	return 0;
 }
 
+string join( const vector< string > &tokens )
+{
+	string ret;
+	for ( size_t i=0; i<tokens.size(); ++i )
+		ret += ( i ? "|" : "" ) + tokens[i];
+	return ret;
+}
+
+int splitTest( const string &arg, const string &sep, const string &expected )
+{
+	string ret = join( Strings::split( arg, sep ) );
+	if ( ret != expected )
+	{
+		cerr << "Test failed: expected [" << expected << "] but got [" << ret << "]" << endl;
+		return 1;
+	}
+	return 0;
+}
+
+// Character-by-character splitter the scanning one must match. Returns false
+// for an unterminated quoted string, which it would read past the end of.
+bool splitReference( const string &str, const string &sep, vector< string > &tokens )
+{
+	const char *p0 = str.data();
+	const char *p = p0;
+	bool cmt = false;
+	char quot = 0;
+
+	while ( *p )
+	{
+		cmt = cmt || ( !quot && *p == ';' );
+		while ( *p && ( cmt || sep.find( *p ) == string::npos ) )
+		{
+			bool esc = false;
+			do
+			{
+				if ( esc )
+					esc = false;
+				else if ( *p == '\\' )
+					esc = true;
+				else if ( quot )
+				{
+					if ( !*p || quot == *p )
+						quot = 0;
+				}
+				else if ( *p == '\'' || *p == '"' )
+					quot = *p;
+
+				if ( quot )
+					++p;
+			}
+			while ( *p && quot );
+
+			if ( !*p )
+				return false;
+			++p;
+		}
+		tokens.push_back( string( p0, p ) );
+		while ( *p && !cmt && sep.find( *p ) != string::npos )
+			++p;
+		p0 = p;
+	}
+	return true;
+}
+
+int splitRandomTest( const string &sep, int count )
+{
+	const char chars[] = "\t :,;'\"\\AB0123456789abcdefghijklmnopqrstuvwxyz";
+	int failed = 0;
+	srand( 7000 );
+	for ( int n=0; n<count; ++n )
+	{
+		string str( rand() % 80, ' ' );
+		for ( size_t i=0; i<str.size(); ++i )
+			str[i] = chars[rand() % ( sizeof chars - 1 )];
+
+		vector< string > expected;
+		if ( !splitReference( str, sep, expected ) )
+			continue;
+		if ( join( Strings::split( str, sep ) ) != join( expected ) )
+		{
+			cerr << "Test failed: [" << str << "] expected [" << join( expected ) << "]" << endl;
+			++failed;
+		}
+	}
+	return failed;
+}
+
+int splitSpansTest()
+{
+	string line = "LBL\tMOV\t%>12,R3\t; comment";
+	StringView tokens[2];
+	size_t count = Strings::split( line, "\t :", tokens, 2 );
+	return	( count != 4 )
+		+	( tokens[0] != "LBL" || tokens[0].data() != line.data() )
+		+	( tokens[1] != "MOV" );
+}
+
+int foldTest()
+{
+	string ret = "previous contents, longer than the result";
+	Strings::fold( "mov 'ab',r5", ret, false );
+	int failed = ( ret != "MOV 'ab',R5" );
+	Strings::fold( "mov 'ab',r5", ret, true );
+	return failed + ( ret != "mov 'ab',r5" );
+}
+
+int extensionTest()
+{
+	return	( Strings::extension( "x.asm" ) != 1 )
+		+	( Strings::extension( "../out/x" ) != string::npos )
+		+	( Strings::extension( "..\\out.d\\x.i" ) != 10 )
+		+	( Strings::extension( "x" ) != string::npos );
+}
+
 int main()
 {
 	return 	touppernotquotedTest( "my name is 'FooBar'. 'FooBar' is my name.", "MY NAME IS 'FooBar'. 'FooBar' IS MY NAME." )
 		+	touppernotquotedTest( "'Hank''s friends'", "'Hank''s friends'" )
 		//+	touppernotquotedTest( "'Hank\\'s friends'", "'Hank\\'s friends'" ) TODO: FIX
-		+	touppernotquotedTest( "\"Hank's friends\"", "\"Hank's friends\"" );
+		+	touppernotquotedTest( "\"Hank's friends\"", "\"Hank's friends\"" )
+		+	splitTest( "LABEL:\tMOV\t%>12,R3\t; comment", "\t :", "LABEL|MOV|%>12,R3|; comment" )
+		+	splitTest( "\tDB\t'A B;C',\"x'y\"\t; it's", "\t :", "|DB|'A B;C',\"x'y\"|; it's" )
+		+	splitTest( "\tTEXT\t'ab\\'c d'", "\t :", "|TEXT|'ab\\'c d'" )
+		+	splitTest( "\tTEXT\t'unterminated d", "\t :", "|TEXT|'unterminated d" )
+		+	splitTest( "X;Y\tDB\t3", "\t :", "X;Y|DB|3" )
+		+	splitTest( "A,,B,';',C", ",", "A|B|';'|C" )
+		+	splitTest( "A,;B,C", ",", "A|;B,C" )
+		+	splitTest( string( "AB\0CD", 5 ), "\t :", "AB" )
+		+	splitTest( "   ", "\t :", "" )
+		+	splitTest( "", "\t :", "" )
+		+	splitTest( "\tDB\t>0123456789ABCDEF,>0123456789ABCDEF,>0123456789ABCDEF,'long quoted string spanning several blocks'", ",",
+				"\tDB\t>0123456789ABCDEF|>0123456789ABCDEF|>0123456789ABCDEF|'long quoted string spanning several blocks'" )
+		+	splitRandomTest( "\t :", 20000 )
+		+	splitRandomTest( ",", 20000 )
+		+	splitSpansTest()
+		+	foldTest()
+		+	extensionTest();
 }
@@ -2,111 +2,288 @@
 
 #include "ArgType.h"
 #include "Log.h"
+#include "Registers.h"
+#include "StringPool.h"
+#include "StringView.h"
 
 #include <string>
-#include <map>
-#include <deque>
+#include <vector>
 
 using namespace std;
 
-/////// SYMBOLS ///////////////////////////////////////////////////////////////
-
-typedef map< string, Arg > 			symbols_t;
-typedef symbols_t::iterator 		symbolptr_t;
-typedef deque< symbols_t >			symstack_t;
-typedef symstack_t::iterator 		symstackptr_t;
+/////// SYMBOL TABLE //////////////////////////////////////////////////////////
 
-class Symbols
+// Values by interned name: open addressing with linear probing, the keys
+// apart from the values so that a probe only reads the keys. Nothing is
+// allocated until the first value is added.
+template< class T >
+class IdTable
 {
 public:
-
-	symstack_t symstack;
-
-	void beginSymbols()
+	IdTable()
+	: count_( 0 ), bits_( 0 )
 	{
-		symstack.push_front( symbols_t() );
 	}
 
-	void endSymbols()
+	T *find( strid_t id )
 	{
-		symstack.pop_front();
+		return const_cast< T* >( static_cast< const IdTable* >( this )->find( id ) );
 	}
 
-	Arg &getSymbol( const string &name )
+	const T *find( strid_t id ) const
 	{
-		static Arg nosym = { ARG_UNDEF, 0xFFFF, "", "" };
-		for ( symstackptr_t it = symstack.begin(); it != symstack.end(); ++it )
+		if ( !count_ || !id )
+			return 0;
+		size_t mask = keys_.size() - 1;
+		for ( size_t i = slot( id ); ; i = ( i + 1 ) & mask )
 		{
-			symbolptr_t itsym = it->find( name );
-			if ( itsym != it->end() )
-				return itsym->second;
+			if ( keys_[i] == id )
+				return &values_[i];
+			if ( !keys_[i] )
+				return 0;
 		}
-		return nosym;
 	}
 
-	void addSymbol( const string &name, ArgType type, word data, const string &str, const string &text )
+	bool contains( strid_t id ) const
 	{
-		if ( symstack.empty() )
+		return find( id ) != 0;
+	}
+
+	// Adds a value, or replaces it in place.
+	void set( strid_t id, const T &value )
+	{
+		size_t i = probe( id );
+		if ( i == keys_.size() || !keys_[i] )
 		{
-			log.error( "BAD: Symbols stack empty !!!" );
+			if ( 2 * ( count_ + 1 ) > keys_.size() )
+			{
+				rehash( bits_ ? bits_ + 1 : 4 );
+				i = probe( id );
+			}
+			keys_[i] = id;
+			++count_;
 		}
-		else
+		values_[i] = value;
+	}
+
+	// Compacts the table to the smallest size keeping it at most half full.
+	void freeze()
+	{
+		if ( !count_ )
+			return;
+		size_t bits = 4;
+		while ( ( size_t( 1 ) << bits ) < 2 * count_ )
+			++bits;
+		if ( bits != bits_ )
+			rehash( bits );
+	}
+
+	size_t size() const
+	{
+		return count_;
+	}
+
+	size_t capacity() const
+	{
+		return keys_.size();
+	}
+
+private:
+	// Fibonacci hashing: the ids are consecutive, the high bits of the
+	// product spread them.
+	size_t slot( strid_t id ) const
+	{
+		return ( unsigned( id ) * 2654435769u ) >> ( 32 - bits_ );
+	}
+
+	// Slot of the id or free slot where it goes, keys_.size() if no table.
+	size_t probe( strid_t id ) const
+	{
+		if ( keys_.empty() )
+			return 0;
+		size_t mask = keys_.size() - 1;
+		size_t i = slot( id );
+		while ( keys_[i] && keys_[i] != id )
+			i = ( i + 1 ) & mask;
+		return i;
+	}
+
+	void rehash( size_t bits )
+	{
+		vector< strid_t > keys;
+		vector< T > values;
+		keys.swap( keys_ );
+		values.swap( values_ );
+
+		bits_ = bits;
+		keys_.assign( size_t( 1 ) << bits, 0 );
+		values_.resize( size_t( 1 ) << bits );
+		count_ = 0;
+
+		for ( size_t i=0; i<keys.size(); ++i )
 		{
-			Arg sym = { type, data, str, text };
-			if ( symstack.front().find( name ) != symstack.front().end() ) // is local ?
-				symstack.front()[name] = sym;
-			else
-				symstack.back()[name] = sym;
+			if ( keys[i] )
+				set( keys[i], values[i] );
 		}
 	}
 
-	void addLocalSymbol( const string &name, ArgType type, word data, const string &str, const string &text )
+	vector< strid_t > keys_;	// 0: free slot
+	vector< T > values_;
+	size_t count_;
+	size_t bits_;
+};
+
+typedef IdTable< Arg > SymbolTable;
+
+/////// SYMBOLS ///////////////////////////////////////////////////////////////
+
+// Global symbols, and the local symbols of the nested scopes (include files,
+// REPT blocks, function calls) in one flat table holding the innermost
+// definition of each name. A local definition shadowing another saves it in
+// the undo log of its scope, restored when the scope ends: entering and
+// leaving a scope costs its locals only, and a lookup is one probe of each
+// table however deep the nesting.
+class Symbols
+{
+public:
+	Symbols()
+	: registers_( false )
+	{
+	}
+
+	void beginSymbols()
 	{
-		if ( symstack.empty() )
+		scopes_.push_back( undo_.size() );
+	}
+
+	void endSymbols()
+	{
+		if ( scopes_.empty() )
+			return;
+		for ( size_t i = undo_.size(); i > scopes_.back(); --i )
 		{
-			log.error( "BAD: Symbols stack empty !!!" );
+			const Undo &undo = undo_[i - 1];
+			*locals_.find( undo.id ) = undo.saved;
 		}
-	//	else if ( symstack.size() == 1 )
-	//	{
-	//		log.error( "BAD: No local symbols map !!!" );
-	//	}
-		else
+		undo_.resize( scopes_.back() );
+		scopes_.pop_back();
+	}
+
+	Arg getSymbol( const StringView &name ) const
+	{
+		return getSymbol( stringpool.find( name ) );	// never interned: not a symbol
+	}
+
+	Arg getSymbol( strid_t id ) const
+	{
+		static const Arg nosym = { ARG_UNDEF, 0xFFFF, 0, 0, 0 };
+		if ( id )
 		{
-			Arg sym = { type, data, str, text };
-			symstack.front()[name] = sym;
+			const Local *local = locals_.find( id );
+			if ( local && local->level )
+				return local->arg;
+			const Arg *sym = globals_.find( id );
+			if ( sym )
+				return *sym;
 		}
+		return nosym;
 	}
 
+	void addSymbol( const string &name, ArgType type, word data, const string &str, const string &text )
+	{
+		Arg sym = { type, data, stringpool.intern( str ), stringpool.intern( text ), 0 };
+		addSymbol( name, sym );
+	}
+
+	void addLocalSymbol( const string &name, ArgType type, word data, const string &str, const string &text )
+	{
+		Arg sym = { type, data, stringpool.intern( str ), stringpool.intern( text ), 0 };
+		addLocalSymbol( name, sym );
+	}
+
+	// Replaces the symbol if it is local to the innermost scope, else
+	// defines it globally.
 	void addSymbol( const string &name, const Arg &arg )
 	{
-		if ( symstack.empty() )
+		if ( scopes_.empty() )
 		{
 			log.error( "BAD: Symbols stack empty !!!" );
 		}
 		else
 		{
-			if ( symstack.front().find( name ) != symstack.front().end() ) // is local ?
-				symstack.front()[name] = arg;
+			registers_ |= Registers::isname( name );
+			strid_t id = stringpool.intern( name );
+			Local *local = scopes_.size() > 1 ? locals_.find( id ) : 0;
+			if ( local && local->level == scopes_.size() ) // is local ?
+				local->arg = arg;
 			else
-				symstack.back()[name] = arg;
+				globals_.set( id, arg );
 		}
 	}
 
 	void addLocalSymbol( const string &name, const Arg &arg )
 	{
-		if ( symstack.empty() )
+		if ( scopes_.empty() )
 		{
 			log.error( "BAD: Symbols stack empty !!!" );
 		}
-	//	else if ( symstack.size() == 1 )
-	//	{
-	//		log.error( "BAD: No local symbols map !!!" );
-	//	}
+		else if ( scopes_.size() == 1 )
+		{
+			registers_ |= Registers::isname( name );
+			globals_.set( stringpool.intern( name ), arg );	// the innermost scope is global
+		}
 		else
 		{
-			symstack.front()[name] = arg;
+			registers_ |= Registers::isname( name );
+			strid_t id = stringpool.intern( name );
+			Local *local = locals_.find( id );
+			if ( local && local->level == scopes_.size() )
+			{
+				local->arg = arg;
+			}
+			else
+			{
+				static const Local none = { { ARG_UNDEF, 0xFFFF, 0, 0, 0 }, 0 };
+				Undo undo = { id, local ? *local : none };
+				undo_.push_back( undo );
+				Local def = { arg, scopes_.size() };
+				locals_.set( id, def );
+			}
 		}
 	}
+
+	// Whether a symbol is named like a register or a port, which then is
+	// looked up before the built-in name.
+	bool definesRegisters() const
+	{
+		return registers_;
+	}
+
+	// End of pass 1: the global symbols are compacted for pass 2, which
+	// only updates them in place.
+	void freeze()
+	{
+		globals_.freeze();
+	}
+
+private:
+	struct Local
+	{
+		Arg		arg;
+		size_t	level;	// depth of the scope defining it, 0 if none
+	};
+
+	struct Undo
+	{
+		strid_t	id;
+		Local	saved;	// definition shadowed
+	};
+
+	SymbolTable globals_;
+	IdTable< Local > locals_;
+	vector< Undo > undo_;
+	vector< size_t > scopes_;	// start of the undo log of each scope
+	bool registers_;			// a symbol redefines Rnn or Pnn
 };
 
 extern Symbols symbols;
@@ -1,6 +1,71 @@
 #include "Symbols.h"
 
+Log log;
+StringPool stringpool;
+
 int main()
 {
-	return 0;
+	int ret = 0;
+
+	// table: grows, replaces in place, compacts
+	SymbolTable table;
+	ret += ( table.find( 1 ) != 0 );
+	for ( strid_t id=1; id<=1000; ++id )
+	{
+		Arg arg = { ARG_IMM, word( id ), 0, 0, 0 };
+		table.set( id, arg );
+	}
+	Arg arg = { ARG_REG, 5, 0, 0, 0 };
+	table.set( 500, arg );
+	ret += ( table.size() != 1000 );
+	ret += ( table.capacity() < 2000 );
+	ret += !table.find( 500 ) || table.find( 500 )->type != ARG_REG;
+	ret += !table.find( 1000 ) || table.find( 1000 )->data != 1000;
+	ret += ( table.find( 1001 ) != 0 );
+	table.freeze();
+	ret += ( table.capacity() != 2048 );
+	ret += !table.find( 999 ) || table.find( 999 )->data != 999;
+
+	// scopes: a symbol goes to the global scope unless it is local
+	Symbols symbols;
+	symbols.beginSymbols();
+	Arg one = { ARG_IMM, 1, 0, 0, 0 };
+	Arg two = { ARG_IMM, 2, 0, 0, 0 };
+	symbols.addSymbol( "X", one );
+	symbols.beginSymbols();
+	symbols.addLocalSymbol( "Y", one );
+	symbols.addLocalSymbol( "X", two );
+	ret += ( symbols.getSymbol( "X" ).data != 2 );
+	symbols.addSymbol( "Y", two );
+	symbols.addSymbol( "Z", two );
+	ret += ( symbols.getSymbol( "Y" ).data != 2 );
+	symbols.endSymbols();
+	ret += ( symbols.getSymbol( "X" ).data != 1 );
+	ret += ( symbols.getSymbol( "Y" ).type != ARG_UNDEF );
+	ret += ( symbols.getSymbol( "Z" ).data != 2 );
+	ret += ( symbols.getSymbol( "NEVER_SEEN" ).type != ARG_UNDEF );
+
+	// shadows restored scope by scope
+	symbols.beginSymbols();
+	symbols.addLocalSymbol( "X", two );
+	symbols.beginSymbols();
+	symbols.beginSymbols();
+	Arg three = { ARG_IMM, 3, 0, 0, 0 };
+	symbols.addLocalSymbol( "X", three );
+	symbols.addLocalSymbol( "X", three );
+	symbols.addSymbol( "X", one );		// local to the innermost scope
+	ret += ( symbols.getSymbol( "X" ).data != 1 );
+	symbols.endSymbols();
+	ret += ( symbols.getSymbol( "X" ).data != 2 );
+	symbols.addSymbol( "X", three );	// not local to this scope: global
+	ret += ( symbols.getSymbol( "X" ).data != 2 );
+	symbols.endSymbols();
+	symbols.endSymbols();
+	ret += ( symbols.getSymbol( "X" ).data != 3 );
+
+	symbols.freeze();
+	symbols.addSymbol( "Z", one );
+	ret += ( symbols.getSymbol( "Z" ).data != 1 );
+
+	return ret;
 }
@@ -4,3 +4,13 @@ echo %CMD%
 %CMD%
 
 fc /b /a TEST.cim TEST.bin
+
+rem single pass: forward and own-line references fixed up as in two passes
+set CMD=ASM7000 -i:FIXUPS -o:FIXUPS -nc -nh -nn
+echo %CMD%
+%CMD%
+set CMD=ASM7000 -i:FIXUPS -o:FIXUPS1 -nc -nh -nn -1
+echo %CMD%
+%CMD%
+
+fc /b /a FIXUPS.cim FIXUPS1.cim